@@ -74,6 +74,11 @@ int OpenclEnvironment::init(const char* str...) {
 	return ret;
 }
 
+void OpenclEnvironment::reserveKernels(int num) {
+	lock_guard<mutex> lock(*m); // thread-safe function
+	vKernel.reserve(vKernel.size() + num);
+}
+
 int OpenclEnvironment::addPlatform(cl_platform_id id) {
 	lock_guard<mutex> lock(*m); // thread-safe function
 	int i;
@@ -668,6 +673,12 @@ int Task::addKernel(cl_kernel krn_id) {
 	return (ret < 0) ? ret : kernelSize() - 1;
 }
 
+void Task::setProgram(cl_program prg_id) {
+	lock_guard<mutex> lock(*father->m); // thread-safe function
+	assert(father->vTask[ref].vrKernel.empty());
+	father->vTask[ref].sId = prg_id;
+}
+
 const OpenclEnvironment& Task::environment() const {
 	return *father;
 }
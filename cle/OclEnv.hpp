@@ -111,6 +111,7 @@ class OpenclEnvironment {
 	int init(const char* str...);
 
 	int addPlatform(cl_platform_id id);
+	void reserveKernels(int num); // Kernels added later do not move the existing ones
 
 	// Accessors
 	Platform platform(int i);
@@ -337,6 +338,7 @@ class Task {
 	int init(const char* str...);
 
 	int addKernel(cl_kernel id);
+	void setProgram(cl_program id); // Only before adding kernels
 
 	const cl_program& id() const;
 	const cl_program& operator*() const;
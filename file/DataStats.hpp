@@ -9,6 +9,7 @@
 #define MAP_FILE_DATASTATS_HPP_
 
 #include <vector>
+#include <cstdint>
 
 
 namespace map { namespace detail {
@@ -30,6 +31,8 @@ struct DataStats {
 	std::vector<type> meanb;
 	std::vector<type> minb;
 	std::vector<type> stdb;
+	std::vector<uint8_t> constb; //!< All values of the block are equal, empty when unknown (then max == min)
+	// Note: bytes rather than vector<bool>, PARAWRITE formats set neighbouring entries concurrently
 	
 	DataStats();
 };
@@ -44,6 +47,7 @@ inline DataStats::DataStats()
 	, meanb()
 	, minb()
 	, stdb()
+	, constb()
 { }
 
 } } // namespace map::detail
@@ -10,6 +10,7 @@
 #include "../file/scalar.hpp"
 #include "../runtime/dag/Node.hpp"
 #include "../runtime/dag/ZonalReduc.hpp"
+#include "../runtime/Runtime.hpp"
 #include <algorithm>
 
 
@@ -72,7 +73,7 @@ IFile* IFile::Factory(Node *node) {
 	{
 		File<binary> *bin_file = new File<binary>(node->metadata());
 		std::string file_path = std::string("tmp") + std::to_string(node->id);
-		Ferr ferr = bin_file->create_temp_file(file_path);
+		Ferr ferr = bin_file->create_temp_file(file_path,Runtime::getConfig().spill_compress);
 		if (ferr) {
 			assert(0);
 		}	
@@ -158,6 +159,26 @@ bool IFile::hasStats() const {
 	return stats.active;
 }
 
+bool IFile::predictBlock(Block &block) const {
+	if (!stats.active)
+		return false;
+
+	int idx = proj(block.key.coord,getNumBlock());
+	block.stats.max = stats.maxb[idx];
+	block.stats.mean = stats.meanb[idx];
+	block.stats.min = stats.minb[idx];
+	block.stats.std = stats.stdb[idx];
+	block.stats.active = true;
+	if (!stats.constb.empty())
+		block.fixed = (stats.constb[idx] != 0);
+	else
+		block.fixed = (block.stats.max.f64 == block.stats.min.f64); // @
+	if (block.fixed)
+		block.value = VariantType(block.stats.max,getDataType());
+
+	return block.fixed;
+}
+
 Ferr IFile::setMetaData(MetaData meta, StreamDir stream_dir) {
 	Ferr ferr = 0;
 	
@@ -56,6 +56,7 @@ class IFile
 	bool isOpen() const;
 	DataStats getDataStats() const;
 	bool hasStats() const;
+	bool predictBlock(Block &block) const;
 
 	/***********
 	   Setters
@@ -68,6 +69,7 @@ class IFile
 	virtual Ferr setMemOrder(MemOrder mem_order) = 0;
 	virtual Ferr setDataSize(DataSize data_size) = 0;
 	virtual Ferr setBlockSize(BlockSize block_size) = 0;
+	virtual Ferr setCompression(CompressType type, int level, bool predictor) = 0;
 	Ferr setDataStats(DataStats stats);
 
 	/***********
@@ -136,6 +138,7 @@ class File : public IFile, public Format
 	virtual Ferr setMemOrder(MemOrder mem_order);
 	virtual Ferr setDataSize(DataSize data_size);
 	virtual Ferr setBlockSize(BlockSize block_size);
+	virtual Ferr setCompression(CompressType type, int level, bool predictor);
 
 	/***********
 	   Methods
@@ -150,7 +153,7 @@ class File : public IFile, public Format
 	virtual Ferr readBlock(Block &block) const;
 	virtual Ferr writeBlock(const Block &block);
 	
-	Ferr create_temp_file(std::string file_path); // @
+	Ferr create_temp_file(std::string file_path, bool compress=false); // @
 	Ferr discard(const Block &block);
 	Ferr setReductionType(const ReductionType &type); // @
 	VariantType value(); // @
@@ -354,6 +357,22 @@ Ferr FILE_DEC::setBlockSize(BlockSize block_size) {
 	return ferr;
 }
 
+template <FILE_TPL>
+Ferr FILE_DEC::setCompression(CompressType type, int level, bool predictor) {
+	Ferr ferr = 0;
+
+	if (is_open) {
+		assert(!"Error in set method, file was open already!");
+	}
+
+	ferr = Format::setCompression(type,level,predictor);
+	if (ferr) {
+		assert(!"Compression not supported by the specific Format");
+	}
+
+	return ferr;
+}
+
 template <FILE_TPL>
 Ferr FILE_DEC::open(std::string file_path, StreamDir stream_dir) {
 	Ferr ferr;
@@ -493,19 +512,8 @@ Ferr FILE_DEC::readBlock(Block &block) const {
 		}
 	}
 
-	if (stats.active) {
-		int idx = proj(block.key.coord,getNumBlock());
-		block.stats.max = stats.maxb[idx];
-		block.stats.mean = stats.meanb[idx];
-		block.stats.min = stats.minb[idx];
-		block.stats.std = stats.stdb[idx];
-		block.stats.active = true;
-		block.fixed = (block.stats.max.f64 == block.stats.min.f64); // @
-		if (block.fixed) {
-			block.value = VariantType(block.stats.max,getDataType());
-			return 0; // No need to read when the value is fixed
-		}
-	}
+	if (predictBlock(block))
+		return 0; // No need to read when the value is fixed
 
 	if (Format::Support::Parallel::PARAREAD == 0)
 		access_mtx.lock();
@@ -555,6 +563,8 @@ Ferr FILE_DEC::writeBlock(const Block &block) {
 		stats.meanb[idx] = block.stats.mean;
 		stats.minb[idx] = block.stats.min;
 		stats.stdb[idx] = block.stats.std;
+		if (!stats.constb.empty())
+			stats.constb[idx] = block.fixed;
 	}
 
 	return ferr;
@@ -564,7 +574,7 @@ Ferr FILE_DEC::writeBlock(const Block &block) {
 // @ Calling them from another File<format> will cause compiling errors
 
 template <FILE_TPL>
-Ferr FILE_DEC::create_temp_file(std::string file_path) { // @
+Ferr FILE_DEC::create_temp_file(std::string file_path, bool compress) { // @
 	Ferr ferr;
 
 	if (is_open) {
@@ -575,7 +585,7 @@ Ferr FILE_DEC::create_temp_file(std::string file_path) { // @
 		assert(!"Format must be configured before creating a temporal file");
 	}
 
-	ferr = Format::create_temp_file();
+	ferr = Format::create_temp_file(compress);
 	if (ferr) {
 		assert(!"Error creating temporal file");
 	}
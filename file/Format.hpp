@@ -82,6 +82,8 @@ class IFormat
 	IFormat(MetaData& meta, DataStats& stats);
 	~IFormat();
 
+	Ferr setCompression(CompressType type, int level, bool predictor); // Hidden by the formats that compress
+
 	//virtual Ferr open(std::string file_path, StreamDir stream_dir) = 0;
 	//virtual Ferr close() = 0;
 
@@ -116,6 +118,11 @@ IFormat<F>::IFormat(MetaData& meta, DataStats& stats)
 template <typename F>
 IFormat<F>::~IFormat() { }
 
+template <typename F>
+Ferr IFormat<F>::setCompression(CompressType type, int level, bool predictor) {
+	return (type != NONE_COMPRESS); // Only uncompressed by default
+}
+
 } } // namespace map::detail
 
 #endif
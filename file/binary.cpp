@@ -9,7 +9,12 @@
  */
 
 #include "binary.hpp"
+#include "codec.hpp"
+#include "ioengine.hpp"
+#include "../runtime/Runtime.hpp"
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <stdio.h>
@@ -22,6 +27,7 @@
 
 
 #define PAGE_SIZE 4096
+#define STATS_OFFSET (PAGE_SIZE/2) // Stats header, after the meta fields in the first page
 
 
 namespace map { namespace detail {
@@ -39,6 +45,27 @@ ssize_t c_pread(int a, void *b, size_t c, off_t d) { return pread(a,b,c,d); }
 ssize_t c_pwrite(int a, const void *b, size_t c, off_t d) { return pwrite(a,b,c,d); }
 int c_close(int a) { return close(a); }
 
+thread_local std::vector<char> enc_buf; //!< Encoded block, one per thread
+
+// Min, max, mean and std of the 'w' x 'h' valid cells of a block with rows of 'row' cells
+template <typename T>
+void scanValues(const void *mem, size_t row, size_t w, size_t h, T &max, T &min, double &mean, double &std) {
+	const T *p = (const T*)mem;
+	double sum = 0, sq = 0;
+	max = min = p[0];
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			T v = p[y*row+x];
+			max = (v > max) ? v : max;
+			min = (v < min) ? v : min;
+			sum += v;
+			sq += (double)v * v;
+		}
+	}
+	mean = sum / (w*h);
+	std = std::sqrt(std::max(0.0, sq/(w*h) - mean*mean));
+}
+
 /***********
    Support
  ***********/
@@ -84,9 +111,18 @@ SUPPORT :: Parallel :: PARAWRITE = 1;
 binary::binary(MetaData& meta, DataStats& stats)
 	: IFormat<binary>(meta,stats)
 	, fd(0)
+	, dio_fd(-1)
+	, map_ptr(nullptr)
+	, map_len(0)
 	, initial_offset(0)
 	, total_data_size(0)
 	, total_block_size(0)
+	, compress(false)
+	, enc_len()
+	, raw_bytes(0)
+	, enc_bytes(0)
+	, stats_pages(0)
+	, blk_rec()
 { }
 
 binary::~binary() { }
@@ -116,6 +152,7 @@ Ferr binary::open(std::string file_path, StreamDir stream_dir) {
 			assert(0);
 		}
 
+		initial_offset = PAGE_SIZE; // getStats() moves it past the stats pages
 		ferr = getStats();
 		if (ferr != 0) {
 			assert(0);
@@ -124,19 +161,22 @@ Ferr binary::open(std::string file_path, StreamDir stream_dir) {
 		// Extra traits go here...
 
 		// Cached variables
-		initial_offset = PAGE_SIZE;
 		total_data_size = meta.getTotalDataSize();
 		total_block_size = meta.getTotalBlockSize();
+		openDirect(file_path.c_str(), stream_dir == IN ? O_RDONLY : O_RDWR); // once the block size is known
+		openMap(stream_dir == IN ? PROT_READ : PROT_READ | PROT_WRITE);
 
 		// TODO: maybe check erroneous file by comparing its length (seek_end-seek_beg) with total_data_size
 	}
 	else if (stream_dir == OUT) 
 	{
-		// Always creates and truncates the file
-		if ((fd = c_open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, (mode_t)0600)) == -1) {
+		// Always creates and truncates the file, mappings need read access too
+		const bool mapped = Runtime::getConfig().mmap_io;
+		if ((fd = c_open(file_path.c_str(), (mapped ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, (mode_t)0600)) == -1) {
 				std::cout << strerror(errno) << std::endl;
 				assert(!"Couldn't create <binary> file for writing!");
 		}
+		openDirect(file_path.c_str(), O_WRONLY);
 
 		// Cached variables
 		initial_offset = PAGE_SIZE;
@@ -148,6 +188,16 @@ Ferr binary::open(std::string file_path, StreamDir stream_dir) {
 			assert(0);
 		}
 
+		// Reserves the per-block stats pages, filled by setStats() when closing
+		blk_rec.assign(prod(meta.num_block),BlockRecord());
+		stats_pages = (blk_rec.size() * sizeof(BlockRecord) + PAGE_SIZE - 1) / PAGE_SIZE;
+		initial_offset = PAGE_SIZE * (1 + stats_pages);
+		c_pwrite(fd, (char*)&stats_pages, sizeof(stats_pages), STATS_OFFSET);
+
+		// The blocks are written through the mapping, the file needs its full length first
+		if (mapped && ftruncate(fd, initial_offset+total_data_size) == 0)
+			openMap(PROT_READ | PROT_WRITE);
+
 		// Extra traits go here...
 	}
 	else
@@ -158,7 +208,7 @@ Ferr binary::open(std::string file_path, StreamDir stream_dir) {
 	return ferr;
 }
 
-Ferr binary::create_temp_file() {
+Ferr binary::create_temp_file(bool compress) {
 	Ferr ferr = 0;
 	char name[] = "mapXXXXXX";
 
@@ -167,12 +217,15 @@ Ferr binary::create_temp_file() {
 			std::cout << strerror(errno) << std::endl;
 			assert(!"Couldn't create temporary <binary> file for reading / writing!");
 	}
+	openDirect(name, O_RDWR);
     unlink(name);
 
 	// Cached variables
 	initial_offset = PAGE_SIZE;
 	total_data_size = meta.getTotalDataSize();
 	total_block_size = meta.getTotalBlockSize();
+	this->compress = compress;
+	enc_len.assign(prod(meta.num_block),0);
 
 	// Truncate file to the desired length
     if (ftruncate(fd, initial_offset+total_data_size) == -1) {
@@ -184,6 +237,8 @@ Ferr binary::create_temp_file() {
 	if (ferr != 0) {
 		assert(0);
 	}
+
+	openMap(PROT_READ | PROT_WRITE);
 		
 	// Extra traits go here...
 
@@ -209,15 +264,57 @@ Ferr binary::close() {
 		assert(!"Unknown or not allowed mode");
 	}
 
+	// Unmapping, the kernel writes the dirty pages back
+	if (map_ptr != nullptr) {
+		munmap(map_ptr, map_len);
+		map_ptr = nullptr;
+	}
+
 	// Closing file
 	ferr = c_close(fd);
 	if (ferr) {
 		assert(0);
 	}
+	if (dio_fd != -1) {
+		c_close(dio_fd);
+		dio_fd = -1;
+	}
 
 	return ferr;
 }
 
+void binary::openDirect(const char *file_path, int flags) {
+	if (!IOEngine::getInstance().direct() || meta.getTotalBlockSize() % PAGE_SIZE != 0)
+		return; // Unaligned blocks would need bounce buffers
+	dio_fd = c_open(file_path, flags | O_DIRECT); // @ -1 on filesystems w/o O_DIRECT (e.g. tmpfs), not an error
+}
+
+int binary::blockFd(const char *mem, size_t size) const {
+	bool aligned = ((size_t)mem % PAGE_SIZE == 0) && (size % PAGE_SIZE == 0);
+	return (dio_fd != -1 && aligned) ? dio_fd : fd;
+}
+
+void binary::openMap(int prot) {
+	struct stat st;
+	if (!Runtime::getConfig().mmap_io || fstat(fd, &st) == -1)
+		return;
+	map_len = initial_offset + total_data_size;
+	if ((size_t)st.st_size < map_len)
+		return; // Truncated file, touching the missing pages would SIGBUS
+
+	void *ptr = mmap(nullptr, map_len, prot, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		std::cout << strerror(errno) << std::endl;
+		return; // Falls back to the IOEngine
+	}
+	map_ptr = (char*)ptr;
+	madvise(map_ptr, map_len, MADV_RANDOM); // Read-ahead follows the scheduler instead, see advise()
+	if (dio_fd != -1) {
+		c_close(dio_fd); // Not used by mapped files
+		dio_fd = -1;
+	}
+}
+
 Ferr binary::getMeta() {
 	Ferr ferr = 0;
 	size_t off = 0;
@@ -287,16 +384,127 @@ Ferr binary::setMeta() {
 
 Ferr binary::getStats() {
 	Ferr ferr = 0;
+	size_t off = STATS_OFFSET;
+	uint8_t active = 0;
+
+	// Files w/o stats have zeros here
+	c_pread(fd, (char*)&stats_pages, sizeof(stats_pages), off);
+	off += sizeof(stats_pages);
+	initial_offset = PAGE_SIZE * (1 + stats_pages);
+	c_pread(fd, (char*)&active, sizeof(active), off);
+	off += sizeof(active);
+	if (stats_pages == 0 || active == 0)
+		return ferr;
+
+	// Global stats
+	c_pread(fd, (char*)&stats.max, sizeof(stats.max), off);
+	off += sizeof(stats.max);
+	c_pread(fd, (char*)&stats.mean, sizeof(stats.mean), off);
+	off += sizeof(stats.mean);
+	c_pread(fd, (char*)&stats.min, sizeof(stats.min), off);
+	off += sizeof(stats.min);
+	c_pread(fd, (char*)&stats.std, sizeof(stats.std), off);
+	off += sizeof(stats.std);
+	assert(off <= PAGE_SIZE);
+
+	// Per-block stats
+	std::vector<BlockRecord> rec_vec(prod((meta.data_size + meta.block_size - 1) / meta.block_size));
+	assert(rec_vec.size() * sizeof(BlockRecord) <= stats_pages * PAGE_SIZE);
+	c_pread(fd, (char*)rec_vec.data(), rec_vec.size() * sizeof(BlockRecord), PAGE_SIZE);
+
+	stats.maxb.resize(rec_vec.size());
+	stats.meanb.resize(rec_vec.size());
+	stats.minb.resize(rec_vec.size());
+	stats.stdb.resize(rec_vec.size());
+	stats.constb.resize(rec_vec.size());
+	for (int i=0; i<rec_vec.size(); i++) {
+		stats.maxb[i] = rec_vec[i].max;
+		stats.meanb[i] = rec_vec[i].mean;
+		stats.minb[i] = rec_vec[i].min;
+		stats.stdb[i] = rec_vec[i].std;
+		stats.constb[i] = rec_vec[i].constant;
+	}
+	stats.active = true;
 
 	return ferr;
 }
 
 Ferr binary::setStats() {
 	Ferr ferr = 0;
+	size_t off = STATS_OFFSET + sizeof(stats_pages);
+	uint8_t active = (stats_pages > 0);
+	DataType dt = meta.data_type;
+	VariantType max, min;
+	double sum = 0, sq = 0;
+	size_t num = 0;
+
+	// Global stats, only when every block was written
+	for (auto &rec : blk_rec) {
+		if (rec.count == 0) {
+			active = 0;
+			break;
+		}
+		max = (num == 0) ? VariantType(rec.max,dt) : ReductionType(MAX).apply(max,VariantType(rec.max,dt));
+		min = (num == 0) ? VariantType(rec.min,dt) : ReductionType(MIN).apply(min,VariantType(rec.min,dt));
+		sum += rec.mean.f64 * rec.count;
+		sq += (rec.std.f64 * rec.std.f64 + rec.mean.f64 * rec.mean.f64) * rec.count;
+		num += rec.count;
+	}
+
+	c_pwrite(fd, (char*)&active, sizeof(active), off);
+	off += sizeof(active);
+	if (!active)
+		return ferr;
+
+	stats.max = max.get();
+	stats.min = min.get();
+	stats.mean.f64 = sum / num;
+	stats.std.f64 = std::sqrt(std::max(0.0, sq/num - stats.mean.f64*stats.mean.f64));
+
+	c_pwrite(fd, (char*)&stats.max, sizeof(stats.max), off);
+	off += sizeof(stats.max);
+	c_pwrite(fd, (char*)&stats.mean, sizeof(stats.mean), off);
+	off += sizeof(stats.mean);
+	c_pwrite(fd, (char*)&stats.min, sizeof(stats.min), off);
+	off += sizeof(stats.min);
+	c_pwrite(fd, (char*)&stats.std, sizeof(stats.std), off);
+	off += sizeof(stats.std);
+	assert(off <= PAGE_SIZE);
+
+	c_pwrite(fd, (char*)blk_rec.data(), blk_rec.size() * sizeof(BlockRecord), PAGE_SIZE);
 
 	return ferr;
 }
 
+void binary::scanBlock(const Block &block, BlockRecord &rec) const {
+	const int num = meta.num_dim.toInt();
+	size_t w = std::min(meta.block_size[0], meta.data_size[0] - block.key.coord[0]*meta.block_size[0]);
+	size_t h = (num < 2) ? 1 : std::min(meta.block_size[1], meta.data_size[1] - block.key.coord[1]*meta.block_size[1]);
+	const void *mem = block.entry->host_mem;
+	double mean, std;
+
+	rec.count = w * h;
+	if (block.fixed) { // Predicted, the block holds 'value' only
+		rec.max = rec.min = block.value.get();
+		rec.mean.f64 = VariantType(block.value).convert(F64).get().f64;
+		rec.std.f64 = 0;
+		rec.constant = 1;
+		return;
+	}
+
+	switch (meta.data_type.get()) {
+		#define SCAN(T) case T: { Ctype<T> max, min; \
+			scanValues(mem,meta.block_size[0],w,h,max,min,mean,std); \
+			rec.max = VariantType(max).get(); rec.min = VariantType(min).get(); \
+			rec.constant = (max == min); break; }
+		SCAN(F32) SCAN(F64) SCAN(B8) SCAN(U8) SCAN(U16) SCAN(U32) SCAN(U64) SCAN(S8) SCAN(S16) SCAN(S32) SCAN(S64)
+		#undef SCAN
+		default: assert(0);
+	}
+	rec.mean.f64 = mean;
+	rec.std.f64 = std;
+}
+
 Ferr binary::read(void* dst, const Coord& beg_coord, const Coord& end_coord) {
 	if (meta.mem_order != ROW || meta.num_dim != D2) {
 		assert(0);
@@ -346,21 +554,30 @@ Ferr binary::readBlock(Block &block) const {
 		assert(0);
 	}
 
-	size_t offset = proj(block.key.coord,meta.num_block) * total_block_size;
+	int idx = proj(block.key.coord,meta.num_block);
+	size_t offset = idx * total_block_size;
 	Ferr ferr = 0;
-	size_t ret, len = 0;
 	char *mem = (char*)block.entry->host_mem;
+	size_t size = total_block_size;
+
+	if (compress && enc_len[idx] > 0) { // Encoded block
+		enc_buf.resize(total_block_size);
+		mem = enc_buf.data();
+		size = enc_len[idx];
+	}
 
 	offset += initial_offset;
-	while (len < total_block_size) {
-		ret = pread(fd, mem+len, total_block_size-len, offset+len);
-		ferr = (ret < 0);
-		if (ferr) {
-			std::cout << strerror(errno) << std::endl;
-			assert(0);
-		}
-		len += ret;
+	if (map_ptr != nullptr && mem != block.entry->host_mem) { // Decoded straight from the mapping
+		decode(map_ptr+offset,size,meta.data_type,block.entry->host_mem,total_block_size);
+		return ferr;
+	} else if (map_ptr != nullptr) {
+		std::memcpy(mem, map_ptr+offset, size);
+		return ferr;
 	}
+	ferr = IOEngine::getInstance().read(blockFd(mem,size), mem, size, offset);
+
+	if (mem != block.entry->host_mem)
+		decode(mem,size,meta.data_type,block.entry->host_mem,total_block_size);
 
 	return ferr;
 }
@@ -370,22 +587,32 @@ Ferr binary::writeBlock(const Block &block) {
 		assert(0);
 	}
 
-	size_t offset = proj(block.key.coord,meta.num_block) * total_block_size;
+	int idx = proj(block.key.coord,meta.num_block);
+	size_t offset = idx * total_block_size;
 	Ferr ferr = 0;
-	size_t ret, len = 0;
 	char *mem = (char*)block.entry->host_mem;
-
-	offset += initial_offset;
-	while (len < total_block_size) {
-		ret = pwrite(fd, mem+len, total_block_size-len, offset+len);
-		ferr = (ret < 0);
-		if (ferr) {
-			std::cout << strerror(errno) << std::endl;
-			assert(0);
+	size_t size = total_block_size;
+
+	if (compress) { // Encoded by the thread doing the write (a Writer or an I/O thread), kept raw when it does not shrink
+		enc_buf.resize(total_block_size);
+		enc_len[idx] = encode(mem,total_block_size,meta.data_type,enc_buf.data());
+		if (enc_len[idx] > 0) {
+			mem = enc_buf.data();
+			size = enc_len[idx];
 		}
-		len += ret;
+		raw_bytes += total_block_size;
+		enc_bytes += size;
 	}
 
+	offset += initial_offset;
+	if (map_ptr != nullptr)
+		std::memcpy(map_ptr+offset, mem, size);
+	else
+		ferr = IOEngine::getInstance().write(blockFd(mem,size), mem, size, offset);
+
+	if (!blk_rec.empty()) // Only OUT files keep per-block stats
+		scanBlock(block,blk_rec[idx]);
+
 	return ferr;
 }
 
@@ -394,13 +621,34 @@ Ferr binary::discard(const Block &block) {
 	size_t offset = proj(block.key.coord,meta.num_block) * total_block_size;
 
 	//ferr = fallocate(fd, FALLOC_FL_ZERO_RANGE, offset+initial_offset, total_block_size);
-	ferr = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset+initial_offset, total_block_size);
+	ferr = -1;
+	if (map_ptr != nullptr && total_block_size % PAGE_SIZE == 0) // Frees the pages and the disk space at once
+		ferr = madvise(map_ptr+offset+initial_offset, total_block_size, MADV_REMOVE);
+	if (ferr) // Not mapped, unaligned, or not supported by the filesystem
+		ferr = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset+initial_offset, total_block_size);
 	if (ferr) {
 		std::cout << strerror(errno) << std::endl;
 		assert(0);
 	}
+	if (compress)
+		enc_len[proj(block.key.coord,meta.num_block)] = 0;
 
 	return ferr;
 }
 
+void binary::advise(const Coord &coord) const {
+	if (map_ptr == nullptr)
+		return;
+	int idx = proj(coord,meta.num_block);
+	size_t beg = initial_offset + idx * total_block_size;
+	size_t len = (compress && enc_len[idx] > 0) ? enc_len[idx] : total_block_size;
+	size_t off = beg % PAGE_SIZE; // madvise() wants page-aligned addresses
+	madvise(map_ptr+beg-off, len+off, MADV_WILLNEED); // @ only a hint, errors are ignored
+}
+
+void binary::spillBytes(size_t &raw, size_t &enc) const {
+	raw = raw_bytes;
+	enc = enc_bytes;
+}
+
 } } // namespace map::detail
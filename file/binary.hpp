@@ -3,6 +3,11 @@
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
  * Format for binary files
+ *
+ * Note: temporal files can hold encoded blocks (see codec.hpp), each at the offset of its raw block, w/o header
+ * Note: the blocks go through the IOEngine (see ioengine.hpp), raw page-aligned blocks use a second O_DIRECT descriptor
+ * Note: with conf.mmap_io the file is mapped instead, blocks are copied from / to the mapping w/o syscalls
+ * Note: OUT files keep per-block stats in the pages after the header, see BlockRecord. Old files have none
  */
 
 #ifndef MAP_FILE_BINARY_HPP_
@@ -10,6 +15,9 @@
 
 #include "Format.hpp"
 #include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
 
 
 namespace map { namespace detail {
@@ -20,24 +28,45 @@ namespace map { namespace detail {
  */
 class binary : public IFormat<binary>
 {
+	/*
+	 * Per-block stats, stored as an array after the header
+	 */
+	struct BlockRecord {
+		DataStats::type max, mean, min, std;
+		int64_t constant; //!< All values are equal
+		int64_t count; //!< Valid cells, 0 when the block was not written
+	};
+
 	int fd; //!< file descriptor
+	int dio_fd; //!< O_DIRECT file descriptor, -1 when not available
+	char *map_ptr; //!< Mapping of the whole file, nullptr when not mapped
+	size_t map_len; //!< Length of the mapping
 	size_t initial_offset, total_data_size, total_block_size; //!< Cached variables
+	bool compress; //!< Encodes the blocks, only for temporal files
+	std::vector<size_t> enc_len; //!< Encoded length of every block, 0 when raw
+	std::atomic<size_t> raw_bytes, enc_bytes; //!< Written bytes before / after encoding
+	size_t stats_pages; //!< Pages of per-block stats after the header, 0 when the file has none
+	std::vector<BlockRecord> blk_rec; //!< Per-block stats of OUT files, filled when writing
 
   protected:
 	binary(const binary& other) = delete;
   	binary& operator=(const binary& other) = delete;
 
   	Ferr getMeta();
+	void openDirect(const char *file_path, int flags);
+	int blockFd(const char *mem, size_t size) const;
+	void openMap(int prot);
 	Ferr setMeta();
 	Ferr getStats();
 	Ferr setStats();
+	void scanBlock(const Block &block, BlockRecord &rec) const;
 
   public:
 	binary(MetaData& meta, DataStats& stats);
 	~binary();
 
 	Ferr open(std::string file_path, StreamDir stream_dir);
-	Ferr create_temp_file();
+	Ferr create_temp_file(bool compress);
 	Ferr close();
 
 	Ferr read(void* dst, const Coord& beg_coord, const Coord& end_coord);
@@ -49,6 +78,8 @@ class binary : public IFormat<binary>
 	Ferr writeBlock(const Block &block);
 
 	Ferr discard(const Block &block);
+	void advise(const Coord &coord) const;
+	void spillBytes(size_t &raw, size_t &enc) const;
 };
 
 } } // namespace map::detail
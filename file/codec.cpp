@@ -0,0 +1,156 @@
+/**
+ * @file    codec.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: RLE follows PackBits, control byte c < 128 --> c+1 literals, c >= 128 --> c-126 repeats of the next byte
+ *
+ * TODO: B8 blocks could be bit-packed before the RLE, see DataType.hpp
+ */
+
+#include "codec.hpp"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+namespace { // anonymous namespace
+
+typedef unsigned char byte;
+
+thread_local std::vector<byte> scratch; //!< Intermediate buffers, one per thread
+
+/*
+ * Decorrelation, each value becomes its difference (or XOR) with the previous one
+ */
+template <typename T, bool XOR>
+void forward(const byte *src, byte *dst, size_t n) {
+	T prev = 0;
+	for (size_t i=0; i<n; i++) {
+		T v, d;
+		std::memcpy(&v,src+i*sizeof(T),sizeof(T));
+		d = XOR ? (v ^ prev) : (v - prev);
+		std::memcpy(dst+i*sizeof(T),&d,sizeof(T));
+		prev = v;
+	}
+}
+
+template <typename T, bool XOR>
+void backward(const byte *src, byte *dst, size_t n) {
+	T prev = 0;
+	for (size_t i=0; i<n; i++) {
+		T d;
+		std::memcpy(&d,src+i*sizeof(T),sizeof(T));
+		prev = XOR ? (d ^ prev) : (d + prev);
+		std::memcpy(dst+i*sizeof(T),&prev,sizeof(T));
+	}
+}
+
+void decorrelate(const byte *src, byte *dst, size_t len, DataType type, bool inverse) {
+	const size_t s = type.sizeOf();
+	const size_t n = len / s;
+	const bool flt = type.isFloating();
+
+	switch (s) {
+		case 1: inverse ? backward<uint8_t,false>(src,dst,n) : forward<uint8_t,false>(src,dst,n); break;
+		case 2: inverse ? backward<uint16_t,false>(src,dst,n) : forward<uint16_t,false>(src,dst,n); break;
+		case 4: if (flt) inverse ? backward<uint32_t,true>(src,dst,n) : forward<uint32_t,true>(src,dst,n);
+				else inverse ? backward<uint32_t,false>(src,dst,n) : forward<uint32_t,false>(src,dst,n); break;
+		case 8: if (flt) inverse ? backward<uint64_t,true>(src,dst,n) : forward<uint64_t,true>(src,dst,n);
+				else inverse ? backward<uint64_t,false>(src,dst,n) : forward<uint64_t,false>(src,dst,n); break;
+		default: assert(0);
+	}
+}
+
+/*
+ * Byte shuffling, groups the k-th bytes of all the values together
+ */
+void shuffle(const byte *src, byte *dst, size_t len, size_t s) {
+	const size_t n = len / s;
+	for (size_t i=0; i<n; i++)
+		for (size_t b=0; b<s; b++)
+			dst[b*n+i] = src[i*s+b];
+}
+
+void unshuffle(const byte *src, byte *dst, size_t len, size_t s) {
+	const size_t n = len / s;
+	for (size_t i=0; i<n; i++)
+		for (size_t b=0; b<s; b++)
+			dst[i*s+b] = src[b*n+i];
+}
+
+/*
+ * Run length encoding, returns 0 when the output exceeds 'cap'
+ */
+size_t rle(const byte *src, size_t len, byte *dst, size_t cap) {
+	size_t i = 0, o = 0;
+
+	while (i < len) {
+		size_t run = 1;
+		while (i+run < len && run < 129 && src[i+run] == src[i])
+			run++;
+
+		if (run >= 3) { // Repeat
+			if (o+2 > cap)
+				return 0;
+			dst[o++] = run + 126;
+			dst[o++] = src[i];
+			i += run;
+		} else { // Literals, till the next repeat
+			size_t beg = i, lit = 0;
+			while (i < len && lit < 128) {
+				if (i+2 < len && src[i] == src[i+1] && src[i] == src[i+2])
+					break;
+				i++;
+				lit++;
+			}
+			if (o+1+lit > cap)
+				return 0;
+			dst[o++] = lit - 1;
+			std::memcpy(dst+o,src+beg,lit);
+			o += lit;
+		}
+	}
+	return o;
+}
+
+void unrle(const byte *src, size_t enc_len, byte *dst, size_t len) {
+	size_t i = 0, o = 0;
+
+	while (i < enc_len && o < len) {
+		size_t c = src[i++];
+		if (c < 128) {
+			std::memcpy(dst+o,src+i,c+1);
+			i += c+1;
+			o += c+1;
+		} else {
+			std::memset(dst+o,src[i++],c-126);
+			o += c-126;
+		}
+	}
+	assert(o == len);
+}
+
+} // anonymous namespace
+
+size_t encode(const void *src, size_t len, DataType type, void *dst) {
+	scratch.resize(2*len);
+	byte *tmp = scratch.data(), *shf = scratch.data() + len;
+
+	decorrelate((const byte*)src,tmp,len,type,false);
+	shuffle(tmp,shf,len,type.sizeOf());
+	return rle(shf,len,(byte*)dst,len-1); // Only if smaller than raw
+}
+
+void decode(const void *src, size_t enc_len, DataType type, void *dst, size_t len) {
+	scratch.resize(2*len);
+	byte *tmp = scratch.data(), *shf = scratch.data() + len;
+
+	unrle((const byte*)src,enc_len,shf,len);
+	unshuffle(shf,tmp,len,type.sizeOf());
+	decorrelate(tmp,(byte*)dst,len,type,true);
+}
+
+} } // namespace map::detail
@@ -0,0 +1,25 @@
+/**
+ * @file    codec.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Lightweight block codec for the spilled (temporal) blocks
+ *
+ * Note: the values are first decorrelated (delta for integers / bools, XOR for floats), then byte-shuffled and RLE encoded
+ * Note: encode() returns 0 when the encoded block would not be smaller, the block should be kept raw then
+ */
+
+#ifndef MAP_FILE_CODEC_HPP_
+#define MAP_FILE_CODEC_HPP_
+
+#include "../util/DataType.hpp"
+#include <cstddef>
+
+
+namespace map { namespace detail {
+
+size_t encode(const void *src, size_t len, DataType type, void *dst);
+void decode(const void *src, size_t enc_len, DataType type, void *dst, size_t len);
+
+} } // namespace map::detail
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @file    ioengine.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: the SQ and CQ rings are single producer / consumer, 'mtx' guards the SQ and only the reaper touches the CQ
+ * Note: a failed registration (e.g. RLIMIT_MEMLOCK) is not an error, the plain read / write are used then
+ */
+
+#include "ioengine.hpp"
+#include "../runtime/Runtime.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <unistd.h>
+
+
+namespace map { namespace detail {
+
+IOEngine& IOEngine::getInstance() {
+	static IOEngine engine(Runtime::getConfig().uring_io, Runtime::getConfig().uring_depth, Runtime::getConfig().direct_io);
+	return engine;
+}
+
+IOEngine::IOEngine(bool use_ring, int depth, bool direct)
+	: ready(false)
+	, use_direct(direct)
+	, reaping(false)
+	, num_queued(0)
+{
+#ifdef LIBURING
+	if (use_ring)
+		ready = (io_uring_queue_init(depth,&uring,0) == 0); // @ old kernels fall back to pread / pwrite
+#endif
+}
+
+IOEngine::~IOEngine() {
+#ifdef LIBURING
+	if (ready)
+		io_uring_queue_exit(&uring);
+#endif
+}
+
+bool IOEngine::ring() const {
+	return ready;
+}
+
+bool IOEngine::direct() const {
+	return use_direct;
+}
+
+void IOEngine::registerBuffers(const std::vector<iovec> &buf_vec) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	assert(num_queued == 0 && !reaping); // Only between evaluations
+	if (!ready || buf_vec.empty())
+		return;
+#ifdef LIBURING
+	if (!iov_vec.empty())
+		io_uring_unregister_buffers(&uring);
+	iov_vec.clear();
+	if (io_uring_register_buffers(&uring,buf_vec.data(),buf_vec.size()) == 0)
+		iov_vec = buf_vec;
+#endif
+}
+
+void IOEngine::unregisterBuffers() {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	assert(num_queued == 0 && !reaping);
+#ifdef LIBURING
+	if (!iov_vec.empty())
+		io_uring_unregister_buffers(&uring);
+#endif
+	iov_vec.clear();
+}
+
+int IOEngine::bufferIndex(const char *mem, size_t size) const {
+	for (int i=0; i<iov_vec.size(); i++) {
+		const char *beg = (const char*)iov_vec[i].iov_base;
+		if (mem >= beg && mem + size <= beg + iov_vec[i].iov_len)
+			return i;
+	}
+	return -1;
+}
+
+int IOEngine::submit(bool is_write, int fd, char *mem, size_t size, size_t offset) {
+#ifdef LIBURING
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+	Request req = {false,0};
+	struct io_uring_sqe *sqe;
+
+	// Prepares the request, the SQ is only full when many requests wait for the reaper
+	while ((sqe = io_uring_get_sqe(&uring)) == nullptr) {
+		if (!reaping) {
+			io_uring_submit(&uring);
+			num_queued = 0;
+		} else {
+			cv.wait(lock);
+		}
+	}
+
+	int idx = bufferIndex(mem,size);
+	if (is_write && idx >= 0)
+		io_uring_prep_write_fixed(sqe,fd,mem,size,offset,idx);
+	else if (is_write)
+		io_uring_prep_write(sqe,fd,mem,size,offset);
+	else if (idx >= 0)
+		io_uring_prep_read_fixed(sqe,fd,mem,size,offset,idx);
+	else
+		io_uring_prep_read(sqe,fd,mem,size,offset);
+	io_uring_sqe_set_data(sqe,&req);
+	num_queued++;
+
+	std::vector<std::pair<Request*,int>> reap_vec;
+	while (!req.done) {
+		if (reaping) {
+			cv.wait(lock);
+			continue;
+		}
+
+		// This thread reaps, submitting all requests queued meanwhile at once
+		reaping = true;
+		if (num_queued > 0) {
+			io_uring_submit(&uring);
+			num_queued = 0;
+		}
+		lock.unlock();
+
+		struct io_uring_cqe *cqe;
+		int ret;
+		while ((ret = io_uring_wait_cqe(&uring,&cqe)) == -EINTR)
+			;
+		assert(ret == 0);
+
+		unsigned head, num = 0;
+		reap_vec.clear();
+		io_uring_for_each_cqe(&uring,head,cqe) {
+			reap_vec.push_back(std::make_pair((Request*)io_uring_cqe_get_data(cqe),cqe->res));
+			num++;
+		}
+		io_uring_cq_advance(&uring,num);
+
+		lock.lock();
+		for (auto &r : reap_vec) {
+			r.first->res = r.second;
+			r.first->done = true;
+		}
+		reaping = false;
+		cv.notify_all();
+	}
+
+	return req.res;
+#else
+	assert(0);
+	return -ENOSYS;
+#endif
+}
+
+Ferr IOEngine::read(int fd, void *mem, size_t size, size_t offset) {
+	char *ptr = (char*)mem;
+	size_t len = 0;
+
+	while (len < size) {
+		ssize_t ret = ready ? submit(false,fd,ptr+len,size-len,offset+len) : pread(fd,ptr+len,size-len,offset+len);
+		if (ret < 0) {
+			std::cout << strerror(ready ? -ret : errno) << std::endl;
+			assert(0);
+			return 1;
+		}
+		len += ret;
+	}
+
+	return 0;
+}
+
+Ferr IOEngine::write(int fd, const void *mem, size_t size, size_t offset) {
+	char *ptr = (char*)mem;
+	size_t len = 0;
+
+	while (len < size) {
+		ssize_t ret = ready ? submit(true,fd,ptr+len,size-len,offset+len) : pwrite(fd,ptr+len,size-len,offset+len);
+		if (ret < 0) {
+			std::cout << strerror(ready ? -ret : errno) << std::endl;
+			assert(0);
+			return 1;
+		}
+		len += ret;
+	}
+
+	return 0;
+}
+
+} } // namespace map::detail
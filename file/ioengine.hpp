@@ -0,0 +1,75 @@
+/**
+ * @file    ioengine.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * I/O engine of the binary files, one io_uring shared by all threads (built with -D LIBURING)
+ *
+ * Note: w/o liburing, or when the ring cannot be set up, the engine falls back to the pread / pwrite loops
+ * Note: requests queued while another thread waits for completions are submitted together, in one syscall
+ * Note: the buffers of the Cache are registered per evaluation, reads / writes within them use the fixed variants
+ * Note: short transfers are resubmitted for the remaining bytes, as the pread / pwrite loops do
+ */
+
+#ifndef MAP_FILE_IOENGINE_HPP_
+#define MAP_FILE_IOENGINE_HPP_
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <sys/uio.h>
+#ifdef LIBURING
+#include <liburing.h>
+#endif
+
+
+namespace map { namespace detail {
+
+typedef int Ferr;
+
+class IOEngine
+{
+	/*
+	 * Request waiting for its completion
+	 */
+	struct Request {
+		bool done;
+		int res; //!< Transferred bytes, or -errno
+	};
+
+  public:
+	static IOEngine& getInstance();
+
+	IOEngine(bool use_ring, int depth, bool direct);
+	~IOEngine();
+	IOEngine(const IOEngine&) = delete;
+	IOEngine& operator=(const IOEngine&) = delete;
+
+	bool ring() const;
+	bool direct() const;
+	void registerBuffers(const std::vector<iovec> &buf_vec);
+	void unregisterBuffers();
+
+	Ferr read(int fd, void *mem, size_t size, size_t offset);
+	Ferr write(int fd, const void *mem, size_t size, size_t offset);
+
+  private:
+	int submit(bool is_write, int fd, char *mem, size_t size, size_t offset);
+	int bufferIndex(const char *mem, size_t size) const;
+
+  private:
+#ifdef LIBURING
+	struct io_uring uring;
+#endif
+	bool ready; //!< The ring was set up
+	bool use_direct; //!< O_DIRECT for the aligned blocks
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool reaping; //!< One thread waits for the completions of all
+	int num_queued; //!< Prepared but not yet submitted
+	std::vector<iovec> iov_vec; //!< Registered buffers
+};
+
+} } // namespace map::detail
+
+#endif
@@ -5,7 +5,17 @@
  */
 
 #include "tiff.hpp"
+#include <zlib.h>
+#ifdef LIBZSTD
+#include <zstd.h>
+#endif
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <iostream>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 
 
 namespace { // anonymous namespace, used for the additional TIFF TAGS
@@ -53,6 +63,9 @@ static void augment_libtiff_with_custom_tags()
 
 namespace map { namespace detail {
 
+thread_local std::vector<char> pred_buf; //!< Tile after the predictor, one per thread
+thread_local std::vector<char> tile_buf; //!< Compressed tile, one per thread
+
 /***********
    Support
  ***********/
@@ -86,8 +99,8 @@ SUPPORT :: MemOrder :: ROW = 1;
 SUPPORT :: MemOrder :: COL = 0;
 SUPPORT :: MemOrder :: SFC = 0;
 
-SUPPORT :: Parallel :: PARAREAD = 0;
-SUPPORT :: Parallel :: PARAWRITE = 0;
+SUPPORT :: Parallel :: PARAREAD = 1;
+SUPPORT :: Parallel :: PARAWRITE = 1; // @ serialized internally, see writeBlock
 
 #undef SUPPORT
 
@@ -97,6 +110,11 @@ SUPPORT :: Parallel :: PARAWRITE = 0;
 
 tiff::tiff(MetaData& meta, DataStats& stats)
 	: IFormat<tiff>(meta,stats)
+	, handler(nullptr)
+	, fd(-1)
+	, compress_type(NONE_COMPRESS)
+	, compress_level(0)
+	, predictor(false)
 {
 	augment_libtiff_with_custom_tags();
 }
@@ -124,6 +142,12 @@ Ferr tiff::open(std::string file_path, StreamDir stream_dir) {
 			assert(0);
 		}
 
+		path = file_path;
+		ferr = getTiles();
+		if (ferr != 0) {
+			assert(0);
+		}
+
 		// Extra traits go here...
 	}
 	else if (stream_dir == OUT)
@@ -162,7 +186,12 @@ Ferr tiff::close() {
 
 	if (meta.stream_dir == IN)
 	{
-		// Nothing to do
+		for (auto tif : handle_pool)
+			TIFFClose(tif);
+		handle_pool.clear();
+		if (fd != -1)
+			::close(fd);
+		fd = -1;
 	}
 	else if (meta.stream_dir == OUT)
 	{
@@ -180,6 +209,25 @@ Ferr tiff::close() {
 	return ferr;
 }
 
+Ferr tiff::setCompression(CompressType type, int level, bool predictor) {
+	Ferr ferr = 0;
+
+	switch (type.get()) {
+		case NONE_COMPRESS: ferr = (predictor || level != 0); break;
+		case DEFLATE: ferr = (level < 0 || level > 9); break;
+		case LZW: ferr = (level != 0); break;
+#ifdef COMPRESSION_ZSTD
+		case ZSTD: ferr = (level < 0 || level > 22); break;
+#endif
+		default: ferr = 1; // Not supported by this libtiff
+	}
+
+	this->compress_type = type;
+	this->compress_level = level;
+	this->predictor = predictor;
+	return ferr;
+}
+
 Ferr tiff::getMeta() {
 	uint32 imageWidth, imageLength;
 	uint32 tileWidth, tileLength;
@@ -484,10 +532,33 @@ Ferr tiff::setOthers() {
 	if (ret != 1) {
 		assert(0);
 	}
-	TIFFSetField(handler, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+	switch (compress_type.get()) {
+		case NONE_COMPRESS: ret = TIFFSetField(handler, TIFFTAG_COMPRESSION, COMPRESSION_NONE); break;
+		case DEFLATE: ret = TIFFSetField(handler, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE); break;
+		case LZW: ret = TIFFSetField(handler, TIFFTAG_COMPRESSION, COMPRESSION_LZW); break;
+#ifdef COMPRESSION_ZSTD
+		case ZSTD: ret = TIFFSetField(handler, TIFFTAG_COMPRESSION, COMPRESSION_ZSTD); break;
+#endif
+		default: assert(0);
+	}
 	if (ret != 1) {
 		assert(0);
 	}
+	if (predictor) {
+		bool fp = (meta.data_type == F32 || meta.data_type == F64);
+		ret = TIFFSetField(handler, TIFFTAG_PREDICTOR, fp ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL);
+		if (ret != 1) {
+			assert(0);
+		}
+	}
+#ifdef COMPRESSION_ZSTD
+	if (compress_type == ZSTD && compress_level != 0 && !threadCompress()) {
+		ret = TIFFSetField(handler, TIFFTAG_ZSTD_LEVEL, compress_level); // Compressed by libtiff
+		if (ret != 1) {
+			assert(0);
+		}
+	}
+#endif
 	TIFFSetField(handler, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
 	if (ret != 1) {
 		assert(0);
@@ -500,6 +571,119 @@ Ferr tiff::setOthers() {
 	return ferr;
 }
 
+Ferr tiff::getTiles() {
+	uint16 compression, planar;
+	uint64 *off, *len;
+	Ferr ferr = 0;
+	int ret;
+
+	// Tile directory, read once
+	const ttile_t num = TIFFNumberOfTiles(handler);
+	ret = TIFFGetField(handler, TIFFTAG_TILEOFFSETS, &off);
+	if (ret != 1) {
+		assert(0);
+	}
+	tile_off.assign(off,off+num);
+	ret = TIFFGetField(handler, TIFFTAG_TILEBYTECOUNTS, &len);
+	if (ret != 1) {
+		assert(0);
+	}
+	tile_len.assign(len,len+num);
+
+	// Uncompressed tiles in host byte order are read w/o libtiff
+	TIFFGetFieldDefaulted(handler, TIFFTAG_COMPRESSION, &compression);
+	TIFFGetFieldDefaulted(handler, TIFFTAG_PLANARCONFIG, &planar);
+	bool raw = (compression == COMPRESSION_NONE) && (planar == PLANARCONFIG_CONTIG) && !TIFFIsByteSwapped(handler);
+	for (auto l : tile_len)
+		raw = raw && (l == 0 || l == (uint64)TIFFTileSize64(handler));
+
+	if (raw && (fd = ::open(path.c_str(), O_RDONLY)) == -1) {
+		std::cout << strerror(errno) << std::endl; // Falls back to the read handles
+	}
+
+	return ferr;
+}
+
+TIFF* tiff::acquireHandle() const {
+	{
+		std::lock_guard<std::mutex> lock(pool_mtx); // thread-safe
+		if (!handle_pool.empty()) {
+			TIFF *tif = handle_pool.back();
+			handle_pool.pop_back();
+			return tif;
+		}
+	}
+	// The pool grows up to the number of concurrent readers
+	TIFF *tif = TIFFOpen(path.c_str(), "r8");
+	if (!tif) {
+		assert(!"Couldn't open another <tiff> handle for reading!");
+	}
+	return tif;
+}
+
+void tiff::releaseHandle(TIFF *tif) const {
+	std::lock_guard<std::mutex> lock(pool_mtx); // thread-safe
+	handle_pool.push_back(tif);
+}
+
+bool tiff::threadCompress() const {
+#ifdef LIBZSTD
+	return compress_type == DEFLATE || compress_type == ZSTD;
+#else
+	return compress_type == DEFLATE; // LZW (and ZSTD w/o libzstd) are left to libtiff, serialized
+#endif
+}
+
+size_t tiff::compressTile(const void *src, std::vector<char> &dst) const {
+	const size_t w = meta.block_size[0], h = meta.block_size[1];
+	const size_t bps = meta.data_type.sizeOf();
+	const size_t row = w * bps, len = row * h;
+
+	if (predictor) { // Same differencing as libtiff, on a copy of the tile
+		pred_buf.resize(len);
+		const char *in = (const char*)src;
+		unsigned char *out = (unsigned char*)pred_buf.data();
+		bool fp = (meta.data_type == F32 || meta.data_type == F64);
+		for (size_t y=0; y<h; y++, in+=row, out+=row) {
+			if (fp) { // Bytes split in planes, most significant first, then byte differencing
+				for (size_t x=0; x<w; x++)
+					for (size_t b=0; b<bps; b++)
+						out[b*w + x] = in[x*bps + (bps-1-b)]; // @ little-endian hosts
+				for (size_t i=row-1; i>0; i--)
+					out[i] -= out[i-1];
+			} else { // Sample differencing, wrapping around
+				std::memcpy(out,in,row);
+				switch (bps) {
+					case 1: for (size_t x=w-1; x>0; x--) out[x] -= out[x-1]; break;
+					case 2: { uint16_t *v = (uint16_t*)out; for (size_t x=w-1; x>0; x--) v[x] -= v[x-1]; break; }
+					case 4: { uint32_t *v = (uint32_t*)out; for (size_t x=w-1; x>0; x--) v[x] -= v[x-1]; break; }
+					case 8: { uint64_t *v = (uint64_t*)out; for (size_t x=w-1; x>0; x--) v[x] -= v[x-1]; break; } // U64 / S64, as libtiff's horDiff64
+					default: assert(0);
+				}
+			}
+		}
+		src = pred_buf.data();
+	}
+
+	if (compress_type == DEFLATE) {
+		uLongf dst_len = compressBound(len);
+		dst.resize(dst_len);
+		int ret = compress2((Bytef*)dst.data(), &dst_len, (const Bytef*)src, len, compress_level ? compress_level : Z_DEFAULT_COMPRESSION);
+		assert(ret == Z_OK);
+		return dst_len;
+	}
+#ifdef LIBZSTD
+	if (compress_type == ZSTD) {
+		dst.resize(ZSTD_compressBound(len));
+		size_t ret = ZSTD_compress(dst.data(), dst.size(), src, len, compress_level ? compress_level : 9); // 9 as libtiff
+		assert(!ZSTD_isError(ret));
+		return ret;
+	}
+#endif
+	assert(0);
+	return 0;
+}
+
 Ferr tiff::read(void* dst, const Coord& beg_coord, const Coord& end_coord) {
 	assert(!"NOT IMPLEMENTED");
 }
@@ -511,8 +695,31 @@ Ferr tiff::write(const void* src, const Coord& beg_coord, const Coord& end_coord
 Ferr tiff::readBlock(Block &block) const {
 	uint32 x_pos_abs = block.key.coord[0] * meta.block_size[0]; // libTIFF takes an absolute index
 	uint32 y_pos_abs = block.key.coord[1] * meta.block_size[1]; // see TIFF reference page for more info
+	ttile_t idx = TIFFComputeTile(handler, x_pos_abs, y_pos_abs, 0, 0); // 'handler' is only read here
+
+	if (tile_len[idx] == 0) { // Sparse tile
+		std::memset(block.entry->host_mem, 0, block.size());
+		return 0;
+	}
+
+	if (fd != -1) { // Uncompressed tile, straight from the file
+		char *mem = (char*)block.entry->host_mem;
+		size_t len = 0, size = tile_len[idx];
+		while (len < size) {
+			ssize_t ret = pread(fd, mem+len, size-len, tile_off[idx]+len);
+			if (ret <= 0) {
+				std::cout << strerror(errno) << std::endl;
+				assert(0);
+				return 1;
+			}
+			len += ret;
+		}
+		return 0;
+	}
 
-	tsize_t ret = TIFFReadTile(handler, block.entry->host_mem, x_pos_abs, y_pos_abs, 0, 0);
+	TIFF *tif = acquireHandle();
+	tsize_t ret = TIFFReadTile(tif, block.entry->host_mem, x_pos_abs, y_pos_abs, 0, 0);
+	releaseHandle(tif);
 
 	return (ret < 0) ? ret : 0;
 }
@@ -520,8 +727,17 @@ Ferr tiff::readBlock(Block &block) const {
 Ferr tiff::writeBlock(const Block &block) {
 	uint32 x_pos_abs = block.key.coord[0] * meta.block_size[0]; // libTIFF takes an absolute index
 	uint32 y_pos_abs = block.key.coord[1] * meta.block_size[1]; // see TIFF reference page for more info
+	tsize_t ret;
 
-	tsize_t ret = TIFFWriteTile(handler, const_cast<void*>(block.entry->host_mem), x_pos_abs, y_pos_abs, 0, 0);
+	if (threadCompress()) { // Compressed by this thread, only appended under the lock
+		size_t len = compressTile(block.entry->host_mem,tile_buf);
+		std::lock_guard<std::mutex> lock(write_mtx); // thread-safe
+		ttile_t idx = TIFFComputeTile(handler, x_pos_abs, y_pos_abs, 0, 0);
+		ret = TIFFWriteRawTile(handler, idx, tile_buf.data(), len);
+	} else {
+		std::lock_guard<std::mutex> lock(write_mtx); // thread-safe
+		ret = TIFFWriteTile(handler, const_cast<void*>(block.entry->host_mem), x_pos_abs, y_pos_abs, 0, 0);
+	}
 
 	return (ret < 0) ? ret : 0;
 }
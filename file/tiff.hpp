@@ -3,6 +3,10 @@
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
  * Format for tiff files
+ *
+ * Note: reads are concurrent (PARAREAD), uncompressed tiles are pread() from the tile directory read at open
+ * Note: other tiles are decoded by libtiff, on a pool of read handles since a TIFF* is not thread-safe
+ * Note: DEFLATE / ZSTD tiles are compressed by the writing threads, only the raw append to 'handler' is serialized
  */
 
 #ifndef MAP_FILE_TIFF_HPP_
@@ -10,6 +14,9 @@
 
 #include "Format.hpp"
 #include "tiffio.h"
+#include <string>
+#include <vector>
+#include <mutex>
 
 
 namespace map { namespace detail {
@@ -20,6 +27,15 @@ namespace map { namespace detail {
 class tiff : public IFormat<tiff>
 {
 	TIFF* handler;
+	std::string path; //!< Opened again by the read handles
+	int fd; //!< Raw file descriptor, -1 unless the tiles are read w/o libtiff
+	std::vector<uint64> tile_off, tile_len; //!< Tile directory, offset and byte count of every tile
+	mutable std::vector<TIFF*> handle_pool; //!< Idle read handles
+	mutable std::mutex pool_mtx; //!< Protects 'handle_pool'
+	CompressType compress_type; //!< Compression of the output tiles
+	int compress_level; //!< Compression level, 0 = codec default
+	bool predictor; //!< Horizontal / floating point predictor
+	std::mutex write_mtx; //!< Serializes the tile appends to 'handler'
 
   protected:
 	tiff(const tiff& other) = delete;
@@ -30,6 +46,11 @@ class tiff : public IFormat<tiff>
 	Ferr getStats();
 	Ferr setStats();
 	Ferr setOthers();
+	Ferr getTiles();
+	TIFF* acquireHandle() const;
+	void releaseHandle(TIFF *tif) const;
+	bool threadCompress() const;
+	size_t compressTile(const void *src, std::vector<char> &dst) const;
 
   public:
 	tiff(MetaData& meta, DataStats& stats);
@@ -37,6 +58,7 @@ class tiff : public IFormat<tiff>
 
 	Ferr open(std::string file_path, StreamDir stream_dir);
 	Ferr close();
+	Ferr setCompression(CompressType type, int level, bool predictor);
 
 	Ferr read(void* dst, const Coord& beg_coord, const Coord& end_coord);
 	Ferr write(const void* src, const Coord& beg_coord, const Coord& end_coord);
@@ -207,8 +207,8 @@ Raster read(const std::string &file_path) {
 	return Raster( ma_read(file_path.data()) );
 }
 
-Rerr write(Raster data, const std::string &file_path) {
-	return ma_write(data.node,file_path.data());
+Rerr write(Raster data, const std::string &file_path, CompressType compress, int level, bool predictor) {
+	return ma_write(data.node,file_path.data(),compress.get(),level,predictor);
 }
 
 Raster zeros(DataSize data_size, DataType data_type, MemOrder mem_order, BlockSize block_size) {
@@ -141,7 +141,7 @@ Raster barrier(Raster data);
 VariantType value(Raster data);
 
 Raster read(const std::string &file_path);
-Rerr write(Raster data, const std::string &file_path);
+Rerr write(Raster data, const std::string &file_path, CompressType compress=NONE_COMPRESS, int level=0, bool predictor=false);
 
 Raster zeros(DataSize data_size=DataSize(), DataType data_type=F32, MemOrder mem_order=ROW+BLK, BlockSize block_size=BlockSize());
 Raster zeros_like(Raster data, DataType type=NONE_DATATYPE, MemOrder mem_order=NONE_MEMORDER);
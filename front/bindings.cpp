@@ -17,6 +17,46 @@ void ma_setupDevices(const char *plat_name, DeviceType dev, const char *dev_name
 	Runtime::getInstance().setupDevices(std::string(plat_name),dev,std::string(dev_name));
 }
 
+void ma_setNumRanks(int num_ranks) { // Before ma_setupDevices, which spawns the workers
+	Runtime::getConfig().setNumRanks(num_ranks);
+}
+
+void ma_setIOEngine(bool uring_io, bool direct_io) { // Before the first binary file is read or written
+	Runtime::getConfig().setIOEngine(uring_io,direct_io);
+}
+
+void ma_setMmapIO(bool mmap_io) { // Before the binary files are opened, e.g. ma_read
+	Runtime::getConfig().setMmapIO(mmap_io);
+}
+
+void ma_setHostCacheSize(size_t host_cache_size) { // Taken by the next evaluation
+	Runtime::getConfig().setHostCacheSize(host_cache_size);
+}
+
+void ma_setPrefetchDepth(int prefetch_depth) {
+	Runtime::getConfig().setPrefetchDepth(prefetch_depth);
+}
+
+void ma_setCachePolicy(PolicyType cache_policy) { // Taken by the next evaluation
+	Runtime::getConfig().setCachePolicy(cache_policy);
+}
+
+void ma_setNumIOThreads(int num_io_threads) { // Before ma_setupDevices, which spawns the I/O threads
+	Runtime::getConfig().setNumIOThreads(num_io_threads);
+}
+
+void ma_setFileQueueDepth(int file_queue_depth) {
+	Runtime::getConfig().setFileQueueDepth(file_queue_depth);
+}
+
+void ma_setNumCompilers(int num_compilers) { // Taken by the next evaluation
+	Runtime::getConfig().setNumCompilers(num_compilers);
+}
+
+void ma_setResultCacheSize(size_t result_cache_size) { // Between evaluations, 0 disables the reuse
+	Runtime::getConfig().setResultCacheSize(result_cache_size);
+}
+
 /**/
 
 void ma_increaseRef(Node *node) {
@@ -96,8 +136,8 @@ Node* ma_read(const char *file_path) {
 	return Runtime::getInstance().addNode(node);
 }
 
-int ma_write(Node *prev, const char *file_path) {
-	Node *write = Write::Factory(prev,file_path);
+int ma_write(Node *prev, const char *file_path, CompressEnum compress, int level, bool predictor) {
+	Node *write = Write::Factory(prev,file_path,compress,level,predictor);
 	write = Runtime::getInstance().addNode(write);
 	write->increaseRef();
 	ma_eval(&write,1); // @ Could be chosen to be LAZY ?
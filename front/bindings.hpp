@@ -11,6 +11,7 @@
 #define MAP_FRONT_BINDINGS_HPP_
 
 #include "../util/util.hpp"
+#include "../runtime/Config.hpp"
 
 
 namespace map { namespace detail {
@@ -25,6 +26,16 @@ extern "C" {
  ***************/
 
 void ma_setupDevices(const char *plat_name, DeviceType dev, const char *dev_name);
+void ma_setNumRanks(int num_ranks);
+void ma_setIOEngine(bool uring_io, bool direct_io);
+void ma_setMmapIO(bool mmap_io);
+void ma_setHostCacheSize(size_t host_cache_size);
+void ma_setPrefetchDepth(int prefetch_depth);
+void ma_setCachePolicy(PolicyType cache_policy);
+void ma_setNumIOThreads(int num_io_threads);
+void ma_setFileQueueDepth(int file_queue_depth);
+void ma_setNumCompilers(int num_compilers);
+void ma_setResultCacheSize(size_t result_cache_size);
 
 void ma_increaseRef(Node *node);
 void ma_decreaseRef(Node *node);
@@ -46,7 +57,7 @@ BlockSize ma_blocksize(Node *node);
  *********/
 
 Node* ma_read(const char *file_path);
-int ma_write(Node *node, const char *file_path);
+int ma_write(Node *node, const char *file_path, CompressEnum compress, int level, bool predictor);
 
 /**************
    Operations
@@ -0,0 +1,38 @@
+from map import * ## "Parallel Map Algebra" package
+import sys
+import os
+import time
+
+setupDevices("",DEV_GPU,"")
+
+## Arguments
+
+assert len(sys.argv) > 2
+in_file_path = sys.argv[1]
+out_dir_path = sys.argv[2]
+
+## Settings (compression, level, predictor)
+
+settings = [
+	(NONE_COMPRESS, 0, False),
+	(DEFLATE, 1, False),
+	(DEFLATE, 6, False),
+	(DEFLATE, 6, True),
+	(LZW, 0, False),
+	(LZW, 0, True),
+	(ZSTD, 1, True),
+	(ZSTD, 9, True)
+]
+
+## Benchmark, end-to-end wall time of each write
+
+dem = read(in_file_path)
+
+for comp, level, pred in settings:
+	name = '%s-%d-%d.tif' % (CompressTypeId[comp], level, pred)
+	out_file_path = os.path.join(out_dir_path, name)
+	beg = time.time()
+	write(dem, out_file_path, comp, level, pred)
+	end = time.time()
+	size = os.path.getsize(out_file_path)
+	print('%-20s %8.3f s %12d bytes' % (name, end-beg, size))
@@ -0,0 +1,41 @@
+from map import * ## "Parallel Map Algebra" package
+import subprocess
+import sys
+import time
+
+## Contention of the Cache: many small jobs retain / release their entries from N workers
+## Usage: contention.py <input> [ranks...]
+
+assert len(sys.argv) > 1
+in_file_path = sys.argv[1]
+
+## Child process, one worker count per process since the workers are spawned by setupDevices
+
+if len(sys.argv) > 3 and sys.argv[2] == '--ranks':
+	ranks = int(sys.argv[3])
+	setNumRanks(ranks)
+	setupDevices("",DEV_CPU,"")
+
+	dem = read(in_file_path)
+	ds = dem.datasize()
+	bs = dem.blocksize()
+	jobs = prod([(ds[i]-1)/bs[i]+1 for i in range(len(ds))])
+
+	rounds = 8
+	out = dem
+	beg = time.time()
+	for r in range(rounds):
+		out = out + 1 ## cheap local task, one retain / release per input and output block
+		eval(zsum(out))
+	end = time.time()
+
+	total = jobs * rounds
+	print('%4d ranks %10d jobs %8.3f s %12.0f jobs/s' % (ranks, total, end-beg, total/(end-beg)))
+	sys.exit(0)
+
+## Parent process, sweeps the number of workers
+
+rank_list = [int(r) for r in sys.argv[2:]] or [1,2,4,8,16,32]
+
+for ranks in rank_list:
+	subprocess.check_call([sys.executable, sys.argv[0], in_file_path, '--ranks', str(ranks)])
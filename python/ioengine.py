@@ -0,0 +1,57 @@
+from map import * ## "Parallel Map Algebra" package
+import subprocess
+import sys
+import os
+import time
+
+## Throughput of the I/O engine of the binary files: pread / pwrite, io_uring, with and w/o O_DIRECT
+## Usage: ioengine.py <input.bin> <output dir>
+## Note: run it as 'make LIBURING=1', otherwise the uring modes fall back to pread / pwrite
+## Note: reads of a file in the page cache measure the copies, drop the caches between modes for the disk
+
+assert len(sys.argv) > 2
+in_file_path = sys.argv[1]
+out_dir_path = sys.argv[2]
+
+## Modes (name, uring, direct)
+
+modes = [
+	('pread', False, False),
+	('pread-direct', False, True),
+	('uring', True, False),
+	('uring-direct', True, True)
+]
+
+## Child process, one mode per process since the engine is created by the first binary file
+
+if len(sys.argv) > 4 and sys.argv[3] == '--mode':
+	name, uring, direct = [m for m in modes if m[0] == sys.argv[4]][0]
+	setIOEngine(uring, direct)
+	setupDevices("",DEV_CPU,"")
+
+	## Read, the input is reduced so that only its blocks are moved
+
+	dem = read(in_file_path)
+	size = os.path.getsize(in_file_path)
+	beg = time.time()
+	eval(zsum(dem))
+	end = time.time()
+	rd = size / (end-beg) / 1024 / 1024
+
+	## Write, a non constant raster so that every block reaches the file
+
+	out_file_path = os.path.join(out_dir_path, '%s.bin' % name)
+	out = dem + index(dem,D1)
+	beg = time.time()
+	write(out, out_file_path)
+	end = time.time()
+	size = os.path.getsize(out_file_path)
+	wr = size / (end-beg) / 1024 / 1024
+
+	print('%-14s read %10.1f MB/s   write %10.1f MB/s' % (name, rd, wr))
+	sys.exit(0)
+
+## Parent process, sweeps the modes
+
+for name, uring, direct in modes:
+	subprocess.check_call([sys.executable, sys.argv[0], in_file_path, out_dir_path, '--mode', name])
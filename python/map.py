@@ -79,8 +79,14 @@ BinaryTypeVal = range(len(BinaryTypeId))
 ReductionTypeId = [ 'NONE_REDUCTION','SUM','PROD','rAND','rOR','MARK_REDUCTION','MAX','MIN','N_REDUCTION' ]
 ReductionTypeVal = range(len(ReductionTypeId))
 
-EnumIds = [ DataTypeId, NumDimId, MemOrderId, DeviceTypeId, UnaryTypeId, BinaryTypeId, ReductionTypeId ]
-EnumVals = [ DataTypeVal, NumDimVal, MemOrderVal, DeviceTypeVal, UnaryTypeVal, BinaryTypeVal, ReductionTypeVal ]
+CompressTypeId = [ 'NONE_COMPRESS','DEFLATE','LZW','ZSTD','N_COMPRESS' ]
+CompressTypeVal = range(len(CompressTypeId))
+
+PolicyTypeId = [ 'NONE_POLICY','LRU_POLICY','COORD_POLICY','N_POLICY' ]
+PolicyTypeVal = range(len(PolicyTypeId))
+
+EnumIds = [ DataTypeId, NumDimId, MemOrderId, DeviceTypeId, UnaryTypeId, BinaryTypeId, ReductionTypeId, CompressTypeId, PolicyTypeId ]
+EnumVals = [ DataTypeVal, NumDimVal, MemOrderVal, DeviceTypeVal, UnaryTypeVal, BinaryTypeVal, ReductionTypeVal, CompressTypeVal, PolicyTypeVal ]
 
 for ids, vals in zip(EnumIds,EnumVals):
 	for i,v in zip(ids,vals):
@@ -451,6 +457,36 @@ for sym,bt in zip(BinaryTypeSym,BinaryTypeVal):
 def setupDevices(plat_name,dev_type,dev_name):
 	_lib.ma_setupDevices(plat_name,dev_type,dev_name)
 
+def setNumRanks(num_ranks):
+	_lib.ma_setNumRanks(num_ranks)
+
+def setIOEngine(uring_io, direct_io):
+	_lib.ma_setIOEngine(uring_io, direct_io)
+
+def setMmapIO(mmap_io):
+	_lib.ma_setMmapIO(mmap_io)
+
+def setHostCacheSize(host_cache_size):
+	_lib.ma_setHostCacheSize(host_cache_size)
+
+def setPrefetchDepth(prefetch_depth):
+	_lib.ma_setPrefetchDepth(prefetch_depth)
+
+def setCachePolicy(cache_policy):
+	_lib.ma_setCachePolicy(cache_policy)
+
+def setNumIOThreads(num_io_threads):
+	_lib.ma_setNumIOThreads(num_io_threads)
+
+def setFileQueueDepth(file_queue_depth):
+	_lib.ma_setFileQueueDepth(file_queue_depth)
+
+def setNumCompilers(num_compilers):
+	_lib.ma_setNumCompilers(num_compilers)
+
+def setResultCacheSize(result_cache_size):
+	_lib.ma_setResultCacheSize(result_cache_size)
+
 def eval(*args):
 	## Note: shadowing built-in functions is considered herecy
 	cond = [isinstance(a,Raster) for a in args]
@@ -472,8 +508,8 @@ def value(arg):
 def read(file):
 	return Raster( _lib.ma_read(file) )
 
-def write(raster,file):
-	return _lib.ma_write(raster,file)
+def write(raster,file,compress=NONE_COMPRESS,level=0,predictor=False):
+	return _lib.ma_write(raster,file,compress,level,predictor)
 
 def _cnst(cnst,ds,dt,mo,bs):
 	var = Variant(cnst).convert(dt)
@@ -723,6 +759,36 @@ def err_write(result,func,args):
 _lib.ma_setupDevices.argtypes = [ct.c_char_p, ct.c_int, ct.c_char_p]
 _lib.ma_setupDevices.restype = None
 
+_lib.ma_setNumRanks.argtypes = [ct.c_int]
+_lib.ma_setNumRanks.restype = None
+
+_lib.ma_setIOEngine.argtypes = [ct.c_bool, ct.c_bool]
+_lib.ma_setIOEngine.restype = None
+
+_lib.ma_setMmapIO.argtypes = [ct.c_bool]
+_lib.ma_setMmapIO.restype = None
+
+_lib.ma_setHostCacheSize.argtypes = [ct.c_size_t]
+_lib.ma_setHostCacheSize.restype = None
+
+_lib.ma_setPrefetchDepth.argtypes = [ct.c_int]
+_lib.ma_setPrefetchDepth.restype = None
+
+_lib.ma_setCachePolicy.argtypes = [ct.c_int]
+_lib.ma_setCachePolicy.restype = None
+
+_lib.ma_setNumIOThreads.argtypes = [ct.c_int]
+_lib.ma_setNumIOThreads.restype = None
+
+_lib.ma_setFileQueueDepth.argtypes = [ct.c_int]
+_lib.ma_setFileQueueDepth.restype = None
+
+_lib.ma_setNumCompilers.argtypes = [ct.c_int]
+_lib.ma_setNumCompilers.restype = None
+
+_lib.ma_setResultCacheSize.argtypes = [ct.c_size_t]
+_lib.ma_setResultCacheSize.restype = None
+
 _lib.ma_increaseRef.argtypes = [Raster]
 _lib.ma_increaseRef.restype = None
 
@@ -759,7 +825,7 @@ _lib.ma_blocksize.restype = Array
 _lib.ma_read.argtypes = [ct.c_char_p]
 _lib.ma_read.restype = Node
 
-_lib.ma_write.argtypes = [Raster, ct.c_char_p]
+_lib.ma_write.argtypes = [Raster, ct.c_char_p, ct.c_int, ct.c_int, ct.c_bool]
 _lib.ma_write.restype = ct.c_int
 _lib.ma_write.errcheck = err_write
 
@@ -113,13 +113,21 @@ Block::Block(Key key, int max_size, int depend)
 
 Block::~Block() { }
 
+cle::Queue Block::queue() {
+	const Config &conf = Runtime::getConfig();
+	int q = Tid.rnk();
+	if (conf.pipeline_depth > 1 && q < conf.num_ranks) // Workers transfer apart, their kernels stay in flight
+		q += conf.num_ranks + conf.num_prefetchers + conf.num_writers;
+	return Runtime::getOclEnv().D(Tid.dev()).Q(q);
+}
+
 Berr Block::send() {
 	TimedRegion region(Runtime::getClock(),SEND);
-	cle::Queue que = Runtime::getOclEnv().D(Tid.dev()).Q(Tid.rnk());
+	cle::Queue que = queue();
 	Berr berr = 0;
 	cl_int clerr;
 
-	if (!fixed) {
+	if (!fixed && !entry->unified) {
 		clerr = clEnqueueWriteBuffer(*que, entry->dev_mem, CL_TRUE, 0, size(), entry->host_mem, 0, nullptr, nullptr);
 		cle::clCheckError(clerr);
 	}
@@ -129,11 +137,13 @@ Berr Block::send() {
 
 Berr Block::recv() {
 	TimedRegion region(Runtime::getClock(),RECV);
-	cle::Queue que = Runtime::getOclEnv().D(Tid.dev()).Q(Tid.rnk());
+	cle::Queue que = queue();
 	Berr berr = 0;
 	cl_int clerr;
 
 	if (!fixed) {
+		if (entry->unified)
+			return berr; // Already in host memory
 		clerr = clEnqueueReadBuffer(*que, entry->dev_mem, CL_TRUE, 0, size(), entry->host_mem, 0, nullptr, nullptr);
 		cle::clCheckError(clerr);
 	} else {
@@ -67,6 +67,7 @@ struct Block
 	~Block();
 
   // Methods
+	static cle::Queue queue(); // Transfer queue of the calling thread
 	Berr send();
 	Berr recv();
 	Berr load(IFile *file);
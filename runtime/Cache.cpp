@@ -5,11 +5,17 @@
  * Note: HOLD_0 leads to null-blocks with null-cl_mem. Null-cl_mem tell the kernel when it is in a border case
  * Note: conf.inmem_cache deactivates the in-memory caching (aka always loads and stores)
  * Note: when inmem_cache is deactivated, the cache still allocates memory chunks and behaves like a pool
+ * Note: pinned buffers are allocated for the workers and the prefetchers, indexed by Tid.proj()
+ * Note: the replacement policy is chosen with conf.cache_policy, see Policy.hpp
+ * Note: entries come in size classes, one per distinct block size. Each class has its own policy, see allocEntries
+ * Note: the policy of a class is split in conf.policy_num_part parts by entry id, each with its own lock
+ *       A worker looks for victims in its own part first, the LRU order is only kept within each part
  *
  * TODO: the reduction functionality within scalar.cpp has to be moved to the cache
- * TODO: pinned_list now has 1 cl_mem per worker, it would need 'max_in_block+max_out_block' if events are activated
- * TODO: try events again in the future, make sure events are de/allocated outside the main worker loop (clCreateUserEvent clReleaseEvent)
+ * Note: the transfers stay blocking, on a queue apart from the kernels of the worker (see Block::queue and Worker)
+ * TODO: pinned_list now has 1 cl_mem per worker, it would need 'max_in_block+max_out_block' for non-blocking transfers
  * TODO: waitForXXX functions should be relative to blocks, not to entries
+ * TODO: an evicted dirty block can be re-loaded by another job before its store finishes (as before sharding)
  */
 
 #include "Cache.hpp"
@@ -17,7 +23,12 @@
 #include "Clock.hpp"
 #include "Config.hpp"
 #include "../file/binary.hpp" // @ needed for getFile
+#include "../file/ioengine.hpp"
+#include "dag/util.hpp"
 #include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
 #include "Runtime.hpp"
 
 
@@ -27,16 +38,32 @@ Cache::Cache(Program &prog, Clock &clock, Config &conf)
 	: prog(prog)
 	, clock(clock)
 	, conf(conf)
-{ }
+	, unified(false)
+	, num_part(0)
+	, host(clock,conf)
+	, write_queue(clock,conf)
+	, io_queue(clock,conf)
+	, result(clock,conf)
+{
+	assert((conf.cache_num_shard & (conf.cache_num_shard-1)) == 0); // power of 2
+	shard_list = std::unique_ptr<Shard[]>(new Shard[conf.cache_num_shard]);
+	shard_mask = conf.cache_num_shard - 1;
+	num_prefetched = 0;
+	prefetch_num_entry = 0;
+	num_batch = 1;
+}
 
 Cache::~Cache() { }
 
 void Cache::clear() {
 	scalar_page = nullptr;
 	chunk_list.clear();
+	chunk_ptr.clear();
+	unified = false;
 	entry_list.clear();
-	lru_list.clear();
-	blk_hash.clear();
+	resetParts(0,0);
+	class_list.clear();
+	clearShards();
 	pinned_mem.clear();
 	pinned_ptr.clear();
 
@@ -45,6 +72,7 @@ void Cache::clear() {
 	file_hash.clear();
 
 	first_time.clear();
+	result.clear();
 }
 
 void Cache::allocChunks(cle::Context ctx) {
@@ -54,14 +82,28 @@ void Cache::allocChunks(cle::Context ctx) {
 	assert(chunk_list.size() == 0); // can't alloc twice
 	assert(scalar_page == nullptr);
 
+	// CPU devices share the host memory, the staging buffers and send / recv are not needed
+	cl_device_type type = *(cl_device_type*) ctx.D(0).get(CL_DEVICE_TYPE);
+	unified = conf.zero_copy && (type == CL_DEVICE_TYPE_CPU);
+	cl_mem_flags flags = CL_MEM_READ_WRITE | (unified ? CL_MEM_ALLOC_HOST_PTR : 0);
+
 	// Allocates chunks of entries
 	chunk_list.resize(conf.cache_num_chunk);
 
 	for (auto &c : chunk_list) {
-		c = clCreateBuffer(*ctx, CL_MEM_READ_WRITE, conf.cache_chunk, nullptr, &err);
+		c = clCreateBuffer(*ctx, flags, conf.cache_chunk, nullptr, &err);
 		cle::clCheckError(err);
 	}
 
+	// Maps the chunks once, they remain mapped till freed
+	if (unified) {
+		for (auto &c : chunk_list) {
+			void *ptr = clEnqueueMapBuffer(*ctx.Q(0), c, CL_TRUE, MAP_READ | MAP_WRITE, 0, conf.cache_chunk, 0, nullptr, nullptr, &err);
+			cle::clCheckError(err);
+			chunk_ptr.push_back((char*)ptr);
+		}
+	}
+
 	// Allocates the chunk of scalars
 	scalar_page = clCreateBuffer(*ctx, CL_MEM_READ_WRITE, conf.scalar_size, nullptr, &err);
 	cle::clCheckError(err);
@@ -75,6 +117,12 @@ void Cache::freeChunks() {
 	if (chunk_list.empty())
 		return;
 
+	// Unmaps the chunks
+	for (int i=0; i<chunk_ptr.size(); i++) {
+		err = clEnqueueUnmapMemObject(*Runtime::getOclEnv().C(0).Q(0), chunk_list[i], chunk_ptr[i], 0, nullptr, nullptr);
+		cle::clCheckError(err);
+	}
+
 	// Releases chunks of entries
 	for (auto &c : chunk_list) {
 		err = clReleaseMemObject(c);
@@ -98,11 +146,23 @@ void Cache::allocEntries() {
 	assert(scalar_page != nullptr);
 	assert(entry_list.size() == 0); // can't alloc twice without freeing before
 
+	// Signs the nodes, their blocks might come from previous evaluations
+	for (auto task : prog.taskList()) {
+		result.sign(task->inputList());
+		result.sign(task->outputList());
+	}
+
 	// Finds the minimum common size for the cache unit
 	unit_mem_size = 0;
 	unit_block_size = BlockSize{1,1};//,1,1}; @
 	unit_dimension = 0;
 
+	// Finds the size classes, i.e. the distinct block sizes of the inputs / outputs (e.g. B8 masks next to F64 rasters)
+	std::map<size_t,size_t> class_bytes; // Block size --> bytes demanded by the nodes of that size
+	std::map<size_t,int> class_min; // Block size --> entries that the largest task retains at once
+	std::set<size_t> class_out; // Block sizes of the output nodes, written behind with their entry reserved
+	std::unordered_set<Node*> node_set;
+
 	for (auto task : prog.taskList()) {
 		for (auto i : task->inputList()) {
 			size_t sz = i->metadata().getTotalBlockSize();
@@ -123,6 +183,28 @@ void Cache::allocEntries() {
 		if (unit_dimension < task->numdim().toInt()) {
 			unit_dimension = task->numdim().toInt();
 		}
+
+		std::map<size_t,int> task_count;
+		for (auto list : {&task->inputList(),&task->outputList()}) {
+			for (auto n : *list) {
+				if (n->numdim() == D0)
+					continue; // Scalars live in the 'scalar_page'
+				size_t sz = n->metadata().getTotalBlockSize();
+				// Focal inputs are retained with their neighborhood of blocks, 3x3 in 2D, see FocalTask::blocksToLoad
+				int nbh = 1;
+				Pattern pat = isInputOf(n,task->group());
+				if (list == &task->inputList() && (pat.is(FOCAL) || pat.is(SPREAD)))
+					for (int d=0; d<n->numdim().toInt(); d++)
+						nbh *= 2*1+1; // halo of 1 block per dimension
+				task_count[sz] += nbh;
+				if (node_set.insert(n).second)
+					class_bytes[sz] += sz;
+				if (n->isOutput())
+					class_out.insert(sz);
+			}
+		}
+		for (auto &tc : task_count)
+			class_min[tc.first] = std::max(class_min[tc.first],tc.second);
 	}
 
 	if (unit_dimension == 0) {
@@ -132,27 +214,98 @@ void Cache::allocEntries() {
 
 	// Establishes the unit size
 	conf.setBlockSize(unit_mem_size);
-	entry_list.reserve(conf.cache_num_entry);
 
-	// Allocation of subbuffers & entries
-	for (auto &chunk : chunk_list) {
-		for (int i=0; i<conf.chunk_num_entry; i++) {
-			_cl_buffer_region reg = {i*unit_mem_size,unit_mem_size};
-			cl_mem subbuf = clCreateSubBuffer(chunk, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &reg, &err);
+	// Sub-buffers must start at multiples of the base address alignment
+	cl_uint align_bits = *(cl_uint*) ctx.D(0).get(CL_DEVICE_MEM_BASE_ADDR_ALIGN);
+	size_t align = align_bits / 8;
+
+	// Workers retain the blocks of every stage in flight, and of a whole batch. Only small blocks in host-shared memory are batched
+	num_batch = (unified && unit_mem_size <= conf.max_batch_block) ? conf.batch_size : 1;
+
+	// Write-behind jobs of output blocks keep their entry until a Writer receives it, one per staging buffer at most
+	int writer_reserve = (conf.num_writers > 0 && conf.inmem_cache) ? conf.write_buffer / unit_mem_size : 0;
+
+	// Every class gets the entries its tasks retain at once, plus the writer reserve. The remaining memory is shared by demanded bytes
+	size_t total_mem = chunk_list.size() * conf.cache_chunk;
+	size_t total_bytes = 0, min_mem = 0;
+	for (auto &cb : class_bytes) {
+		size_t sz = (cb.first + align - 1) / align * align;
+		class_min[cb.first] *= conf.num_ranks * num_batch * conf.pipeline_depth;
+		if (class_out.count(cb.first))
+			class_min[cb.first] += writer_reserve;
+		min_mem += class_min[cb.first] * sz;
+		total_bytes += cb.second;
+	}
+	assert(min_mem <= total_mem); // @ the cache is too small for the tasks (or conf.write_buffer too large)
+
+	class_list.clear();
+	for (auto it=class_bytes.rbegin(); it!=class_bytes.rend(); it++) { // From the largest
+		SizeClass cls;
+		cls.block_size = it->first;
+		cls.entry_size = (it->first + align - 1) / align * align;
+		cls.num_entry = class_min[it->first];
+		cls.num_entry += (total_mem - min_mem) * (it->second / (double)total_bytes) / cls.entry_size;
+		class_list.push_back(cls);
+	}
+
+	// The policy might have changed since the last evaluation, there is one policy per class and part
+	int max_entry = 0;
+	for (auto &cls : class_list)
+		max_entry += cls.num_entry;
+	resetParts(class_list.size(),max_entry);
+
+	// Allocation of subbuffers & entries, carved first-fit from the chunks, largest class first
+	std::vector<size_t> chunk_off(chunk_list.size(),0);
+
+	for (int k=0; k<class_list.size(); k++) {
+		SizeClass &cls = class_list[k];
+		int num = 0, c = 0;
+		for (; num<cls.num_entry; num++) {
+			while (c < chunk_list.size() && chunk_off[c] + cls.entry_size > conf.cache_chunk)
+				c++;
+			if (c == chunk_list.size())
+				break; // The chunks are full, fragmentation left less than planned
+			size_t off = chunk_off[c];
+			chunk_off[c] += cls.entry_size;
+
+			_cl_buffer_region reg = {off,cls.entry_size};
+			cl_mem subbuf = clCreateSubBuffer(chunk_list[c], CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &reg, &err);
 			cle::clCheckError(err);
 
 			// TODO: what would happe if the subbuffer are touched here?
 
 			// Creates Entry, linked to the subbuffer
-			entry_list.push_back( Entry(subbuf) );
-			lru_list.push_back( &entry_list.back() );
-			lru_list.back()->self = std::next(lru_list.rbegin()).base();
+			entry_list.emplace_back(subbuf,entry_list.size());
+			entry_list.back().cls = k;
+			entry_list.back().chunk = chunk_list[c];
+			entry_list.back().offset = off;
+			if (unified) { // The subbuffer is permanently accessible from the host
+				entry_list.back().host_mem = chunk_ptr[c] + off;
+				entry_list.back().unified = true;
+			}
+			partOf(&entry_list.back()).policy->insert( &entry_list.back() );
 		}
+		cls.num_entry = num;
+		assert(cls.num_entry >= class_min[cls.block_size]);
 	}
 
+	// Allocation of the host tier
+	host.allocSlots(unit_mem_size);
+
+	// Allocation of the write-behind staging buffers
+	write_queue.allocBuffers(ctx,unit_mem_size);
+
+	// The I/O threads serve the files of this evaluation
+	io_queue.open();
+
+	// Limits the entries that prefetched blocks can take
+	num_prefetched = 0;
+	prefetch_num_entry = entry_list.size() * conf.prefetch_limit;
+
 	// Allocation of pinned buffers
-	pinned_mem.resize(conf.num_ranks);
-	pinned_ptr.resize(conf.num_ranks);
+	const int num_pinned = unified ? 0 : conf.num_ranks + conf.num_prefetchers;
+	pinned_mem.resize(num_pinned);
+	pinned_ptr.resize(num_pinned);
 
 	for (int i=0; i<pinned_mem.size(); i++) {
 		pinned_mem[i] = clCreateBuffer(*ctx, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, unit_mem_size, nullptr, &err);
@@ -160,6 +313,14 @@ void Cache::allocEntries() {
 		pinned_ptr[i] = clEnqueueMapBuffer(*ctx.Q(0),pinned_mem[i], CL_TRUE, MAP_READ | MAP_WRITE, 0, unit_mem_size, 0, nullptr, nullptr, &err);
 		cle::clCheckError(err);
 	}
+
+	// The binary files read / write the blocks into these buffers, registered once for the whole evaluation
+	std::vector<iovec> buf_vec;
+	for (auto ptr : chunk_ptr)
+		buf_vec.push_back(iovec{ptr,conf.cache_chunk});
+	for (auto ptr : pinned_ptr)
+		buf_vec.push_back(iovec{ptr,unit_mem_size});
+	IOEngine::getInstance().registerBuffers(buf_vec);
 }
 
 void Cache::freeEntries() {
@@ -173,7 +334,8 @@ void Cache::freeEntries() {
 		cle::clCheckError(err);
 	}
 
-	// Release of pinned buffers
+	// Release of pinned buffers, unregistered first
+	IOEngine::getInstance().unregisterBuffers();
 	for (int i=0; i<pinned_mem.size(); i++) {
 		err = clEnqueueUnmapMemObject(*ctx.Q(0), pinned_mem[i], pinned_ptr[i], 0, nullptr, nullptr);
 		cle::clCheckError(err);
@@ -181,13 +343,38 @@ void Cache::freeEntries() {
 		cle::clCheckError(err);
 	}
 
+	// Release of the host tier
+	host.freeSlots();
+
+	// Release of the write-behind staging buffers, the writes were drained
+	write_queue.freeBuffers(ctx);
+
+	// Spilling statistics, before the temporal files are deleted
+	spill_list.clear();
+	for (auto it : file_hash) {
+		auto *bin_file = dynamic_cast<File<binary>*>(it.second);
+		size_t raw, enc;
+		if (bin_file == nullptr)
+			continue;
+		bin_file->spillBytes(raw,enc);
+		if (raw > 0)
+			spill_list.push_back(std::make_tuple(it.first->id,raw,enc));
+	}
+	std::sort(spill_list.begin(),spill_list.end());
+
+	// The result cache outlives the evaluation, not the signatures of its nodes
+	result.unsign();
+
 	// chunk is not cleared!
 	// scalar is not cleared!
 	entry_list.clear();
-	lru_list.clear();
-	blk_hash.clear();
+	resetParts(0,0);
+	clearShards();
 	pinned_mem.clear();
 	pinned_ptr.clear();
+	num_prefetched = 0;
+	prefetch_num_entry = 0;
+	num_batch = 1;
 	
 	for (auto it : file_hash)
 		delete it.second;
@@ -288,9 +475,34 @@ void Cache::releaseOutputBlocks(BlockList &out_blk, const OutKeyList &out_keys)
 	out_blk.clear();
 }
 
+Cache::Shard& Cache::shardOf(const Key &key) {
+	// 'key_hash' keeps the node in the low bits and the coord in the high bits, both are mixed
+	std::size_t h = key_hash()(key);
+	h ^= h >> 32;
+	h *= 0x9E3779B97F4A7C15ull; // Fibonacci hashing
+	return shard_list[(h >> 40) & shard_mask];
+}
+
+Block* Cache::findBlock(Shard &shard, const Key &key, int depend) {
+	// Note: the caller must hold 'shard.mtx'
+	auto it = shard.blk_hash.find(key);
+	if (it != shard.blk_hash.end()) // Found, retrieves block
+		return it->second.get();
+	// Not found, needs new Block
+	Block *blk = new Block(key,unit_mem_size,depend);
+	shard.blk_hash[key] = std::unique_ptr<Block>(blk);
+	return blk;
+}
+
+void Cache::clearShards() {
+	for (int i=0; i<conf.cache_num_shard; i++)
+		shard_list[i].blk_hash.clear();
+}
+
 Block* Cache::retainEntryForInput(const Key &key) {
 	Block *blk = nullptr;
-	mtx_blk.lock(); // thread-safe
+	Shard &shard = shardOf(key);
+	std::unique_lock<std::mutex> lock(shard.mtx); // thread-safe, only this shard
 
 	if (not conf.inmem_cache) // no-cache mode
 	{
@@ -298,56 +510,50 @@ Block* Cache::retainEntryForInput(const Key &key) {
 	}
 	else // Normal mode, cache activated
 	{
-		auto it = blk_hash.find(key);
-		if (it != blk_hash.end()) // Found, retrieves block
-		{
-			blk = it->second.get();
-		}
-		else // Not found, needs new Block
-		{
-			blk = new Block(key,unit_mem_size,DEPEND_UNKNOWN);
-			blk_hash[key] = std::unique_ptr<Block>(blk);
-		}
+		blk = findBlock(shard,key,DEPEND_UNKNOWN);
 	}
-	
-	mtx_blk.unlock();
-	mtx.lock(); // thread-safe
 
 	if (blk->entry != nullptr) // Has a valid entry
 	{
 		clock.incr(NOT_LOADED);
-		blk->entry->setUsed();
-		waitForLoader(blk->entry); // wait till other jobs load it from disk
+		Entry *entry = blk->entry;
+		if (useEntry(entry))
+			clock.incr(PREFETCH_HIT);
+		lock.unlock();
+		waitForLoader(entry); // wait till other jobs (or prefetchers) load it from disk
 	}
-	else if (blk->fixed) // The block doesn't need an entry when the value is fixed
+	else if (blk->fixed || predictInput(blk)) // The block doesn't need an entry when the value is fixed
 	{
 		clock.incr(NOT_LOADED);
 	}
-	else // no entry: evicts LRU, takes its entry and load memory
+	else // no entry: evicts a victim, takes its entry and load memory
 	{
-		Entry *entry = getLRU();
-		Block *old_blk = entry->block;
+		Block victim;
+		Entry *entry = getVictim(shard,victim,classOf(blk)); // returns 'used' and 'loading'
 
 		entry->block = blk;
 		blk->entry = entry;
+		lock.unlock(); // other jobs will wait for the loader
 
-		entry->setUsed();
-		entry->setLoading();
+		if (conf.num_prefetchers > 0)
+			clock.incr(PREFETCH_MISS);
 
-		evict(old_blk);
+		evict(&victim);
 		load(blk);
 
+		entry->mtx.lock();
 		entry->unsetLoading();
-		notifyLoaders();
+		entry->mtx.unlock();
+		notifyLoaders(entry);
 	}
 
-	mtx.unlock();
 	return blk;
 }
 
 Block* Cache::retainEntryForOutput(const Key &key, int depend) {
 	Block *blk = nullptr;
-	mtx_blk.lock(); // thread-safe
+	Shard &shard = shardOf(key);
+	std::unique_lock<std::mutex> lock(shard.mtx); // thread-safe, only this shard
 
 	if (not conf.inmem_cache) // no-cache mode
 	{
@@ -355,59 +561,79 @@ Block* Cache::retainEntryForOutput(const Key &key, int depend) {
 	}
 	else // Normal mode, cache activated
 	{
-		auto it = blk_hash.find(key);
-		if (it != blk_hash.end()) // Found, retrieves block
-		{
-			blk = it->second.get();
-		}
-		else // Not found, needs new Block
-		{
-			blk = new Block(key,unit_mem_size,depend);
-			blk_hash[key] = std::unique_ptr<Block>(blk);
-		}
+		blk = findBlock(shard,key,depend);
 	}
-	
-	mtx_blk.unlock();
-	mtx.lock(); // thread-safe
 
 	if (blk->entry != nullptr) // Has a valid entry
 	{
 		//clock.incr(NOT_LOADED);
-		blk->entry->setUsed();
-		waitForLoader(blk->entry);
-		waitForWriter(blk->entry); // wait till other jobs finish writing
-		blk->entry->setWriting();
+		Entry *entry = blk->entry;
+		useEntry(entry);
+		lock.unlock();
+		waitForWriter(entry); // wait till other jobs finish loading / writing, then sets 'writing'
 	}
 	else if (blk->fixed) // The block doesn't need an entry when the value is fixed
 	{
 		assert(!"Not supposed to reach here");
 	}
-	else // not found: evicts LRU, takes its entry and load memory
+	else // not found: evicts a victim, takes its entry and load memory
 	{
-		Entry *entry = getLRU();
-		Block *old_blk = entry->block;
+		Block victim;
+		Entry *entry = getVictim(shard,victim,classOf(blk)); // returns 'used' and 'loading'
 
 		entry->block = blk;
 		blk->entry = entry;
-		
-		entry->setUsed();
-		entry->setLoading();
+		lock.unlock();
 
-		evict(old_blk);
+		evict(&victim);
 		loadOut(blk);
 
+		entry->mtx.lock();
 		entry->unsetLoading();
-		notifyLoaders();
-		entry->setWriting(); // TODO: check for race conditions
+		entry->setWriting(); // no race, 'loading' kept other jobs waiting till now
+		entry->mtx.unlock();
+		notifyLoaders(entry);
 	}
 
-	mtx.unlock();
 	return blk;
 }
 
-void Cache::releaseEntryFromInput(Block *blk) {
-	mtx.lock(); // thread-safe
-	Entry *entry = blk->entry; // Saves pointer in case 'blk' is discarded
+void Cache::skipInputBlocks(const InKeyList &in_keys) {
+	// Note: the job reused all its outputs, its inputs are notified as used without being loaded
+	if (not conf.inmem_cache)
+		return; // Blocks are created / deleted by every job, there are no dependencies to notify
+
+	for (auto &i : in_keys) {
+		if (std::get<1>(i) != HOLD_N)
+			continue; // Null and scalar blocks only live during the job
+		Shard &shard = shardOf(std::get<0>(i));
+		std::unique_lock<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+
+		auto it = shard.blk_hash.find(std::get<0>(i));
+		if (it == shard.blk_hash.end())
+			continue; // Never retained, its dependencies are unknown (e.g. blocks of input files)
+		Block *blk = it->second.get();
+		Entry *entry = blk->entry; // Used meanwhile, a discarded block might have to be received
+		if (entry != nullptr)
+			useEntry(entry);
+
+		Block saved;
+		bool save = notifyInput(shard,blk,saved);
+		lock.unlock();
+
+		if (save) {
+			waitForLoader(entry); // a prefetcher might be loading it still
+			saveResult(&saved);
+		}
+		if (entry != nullptr)
+			unuseEntry(entry);
+	}
+}
+
+bool Cache::notifyInput(Shard &shard, Block *blk, Block &saved) {
+	// Note: the caller holds 'shard.mtx' and uses the entry of 'blk', if any
+	Entry *entry = blk->entry;
+	bool save = false;
 
 	// Notifying that block has been used
 	blk->notify();
@@ -415,108 +641,456 @@ void Cache::releaseEntryFromInput(Block *blk) {
 	// Discarding. Avoids evicting blocks that will not be used anymore
 	if (blk->discardable()) {
 		clock.incr(DISCARDED);
+		if (blk->entry != nullptr && isReusable(blk)) {
+			saved = *blk; // 'entry' stays used till received, no victim search can take it
+			save = true;
+		}
 		// NOTE: binary::discard is not optimal on linux kernel < 4.6
 		auto *bin_file = dynamic_cast<File<binary>*>( getFile(blk->key.node) );
 		bin_file->discard(*blk);
+		host.drop(blk->key);
 		
-		if (blk->entry != nullptr) {
-			makeLRU(blk->entry);
+		if (blk->entry != nullptr) { // Without block, the policy replaces the entry first
+			std::lock_guard<std::mutex> entry_lock(entry->mtx);
+			unsetPrefetched(entry);
 			blk->entry->unsetDirty();
 			blk->entry->block = nullptr;
 			blk->entry = nullptr;
 		}
 		
-		mtx_blk.lock();
-		blk_hash.erase(blk->key); // deletes blocks that won't be needed anymore
-		mtx_blk.unlock();
+		shard.blk_hash.erase(blk->key); // deletes blocks that won't be needed anymore
 	}
-	
-	if (entry != nullptr)
-		entry->unsetUsed();
 
-	if (not conf.inmem_cache) {
-		delete blk; // Always delete in no-cache mode
-		entry->block = nullptr;
+	return save;
+}
+
+void Cache::releaseEntryFromInput(Block *blk) {
+	Shard &shard = shardOf(blk->key);
+	std::unique_lock<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+	Entry *entry = blk->entry; // Saves pointer in case 'blk' is discarded
+	Block saved; // Copy of a discarded block whose result is kept, received after releasing the shard
+
+	bool save = notifyInput(shard,blk,saved);
+
+	// Always deletes in no-cache mode. Unlinks first, victim searches on other shards read 'entry->block'
+	if (not conf.inmem_cache && entry != nullptr) {
+		std::lock_guard<std::mutex> entry_lock(entry->mtx);
+		if (entry->block == blk)
+			entry->block = nullptr;
 	}
+	lock.unlock();
 
-	mtx.unlock();
+	if (save)
+		saveResult(&saved);
+	
+	if (entry != nullptr)
+		unuseEntry(entry);
+
+	if (not conf.inmem_cache)
+		delete blk;
 }
 
 void Cache::releaseEntryFromOutput(Block *blk) {
-	mtx.lock(); // thread-safe
 	Entry *entry = blk->entry; // Saves pointer in case 'blk' discards 'entry'
-	
-	blk->entry->setDirty();
+	// Note: 'entry' is used and being written, no other job can unlink it from 'blk'
+
+	entry->mtx.lock();
+	entry->setDirty();
+	entry->mtx.unlock();
 
 	// Inmediatelly stores 'output blocks', or when cache is deactivated
 	if (blk->key.node->isOutput() || !conf.inmem_cache) {
+		if (write_queue.enabled() && conf.inmem_cache && !blk->fixed) {
+			// Written behind, the entry stays reserved till a Writer receives the data and releases it
+			WriteJob job = {*blk,write_queue.acquire(),entry};
+			write_queue.push(job);
+			return;
+		}
 		store(blk);
-		blk->entry->unsetDirty();
+		std::lock_guard<std::mutex> entry_lock(entry->mtx);
+		entry->unsetDirty();
 	} else {
 		clock.incr(NOT_STORED);
 	}
 
-	// what about makeLRU() when the out-block is written and not needed anymore?
-
-	// Releases entry and moves it to the LRU if block.max == min
+	// Releases entry, the policy will replace it first, if block.max == min
 	if (blk->fixed) {
-		makeLRU(blk->entry);
-		blk->entry->unsetDirty();
-		blk->entry->block = nullptr;
+		Shard &shard = shardOf(blk->key);
+		std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+		std::lock_guard<std::mutex> entry_lock(entry->mtx);
+		entry->unsetDirty();
+		entry->block = nullptr;
 		blk->entry = nullptr;
 	}
 
+	entry->mtx.lock();
 	entry->unsetWriting();
-	notifyWriters();
-	
-	entry->unsetUsed();
+	if (not conf.inmem_cache && entry->block == blk)
+		entry->block = nullptr; // Unlinked before the delete, see releaseEntryFromInput
+	entry->mtx.unlock();
+	unuseEntry(entry);
+	notifyWriters(entry);
 
-	if (not conf.inmem_cache) {
+	if (not conf.inmem_cache)
 		delete blk;
-		entry->block = nullptr;
+}
+
+Entry* Cache::getVictim(Shard &shard, Block &victim, int cls) {
+	// Only entries of the same size class are candidates, starting by the part of this thread
+	for (int p=0; p<num_part; p++) {
+		PolicyPart &part = part_list[cls*num_part + (Tid.rnk()+p) % num_part];
+		std::lock_guard<std::mutex> lock(part.mtx); // thread-safe, only this part
+		IPolicy *policy = part.policy.get();
+
+		// Note: the caller holds 'shard.mtx', the shards of other victims are only try-locked to avoid deadlocks
+		for (Entry *entry = policy->first(); entry != nullptr; entry = policy->next(entry)) {
+			std::lock_guard<std::mutex> entry_lock(entry->mtx);
+			assert(!entry->isUsed()); // Used entries are never candidates
+
+			Block *old = entry->block;
+			if (old != nullptr) {
+				Shard &old_shard = shardOf(old->key);
+				if (&old_shard != &shard && !old_shard.mtx.try_lock())
+					continue; // Busy shard, tries with the next candidate
+				// Unlinks the old block, keeping a copy if it has to be stored
+				if (entry->isDirty()) {
+					victim = *old;
+					entry->unsetDirty();
+				}
+				old->entry = nullptr;
+				if (&old_shard != &shard)
+					old_shard.mtx.unlock();
+				clock.incr(REPLACED);
+			}
+			entry->block = nullptr;
+			unsetPrefetched(entry); // Prefetched, but evicted before being used
+
+			// Not evictable anymore, other jobs wait for the loader
+			policy->remove(entry);
+			entry->setUsed();
+			entry->setLoading();
+			return entry;
+		}
+	}
+	assert(!"Reached end of the policy without finding a victim");
+}
+
+Entry* Cache::getFree(int cls) {
+	for (int p=0; p<num_part; p++) {
+		PolicyPart &part = part_list[cls*num_part + (Tid.rnk()+p) % num_part];
+		std::lock_guard<std::mutex> lock(part.mtx); // thread-safe, only this part
+		IPolicy *policy = part.policy.get();
+
+		// Free entries (i.e. w/o block) are the first candidates of every policy
+		Entry *entry = policy->first();
+		if (entry == nullptr)
+			continue;
+
+		std::lock_guard<std::mutex> entry_lock(entry->mtx);
+		if (entry->block != nullptr)
+			continue; // No free entries in this part, the candidates hold blocks
+
+		policy->remove(entry);
+		entry->setUsed();
+		entry->setLoading();
+		entry->prefetched = true;
+		num_prefetched++;
+		return entry;
 	}
+	return nullptr;
+}
 
-	mtx.unlock();
+Cache::PolicyPart& Cache::partOf(const Entry *entry) {
+	return part_list[entry->cls*num_part + entry->id % num_part];
 }
 
-Entry* Cache::getLRU() {
-	//std::unique_lock<std::mutex> lock(mtx_lru); // thread-safe
+void Cache::resetParts(int num_class, int num_entry) {
+	// Every part indexes its entries by 'Entry::id', like a whole policy
+	num_part = conf.policy_num_part;
+	part_list = std::unique_ptr<PolicyPart[]>(new PolicyPart[num_class*num_part]);
+	for (int i=0; i<num_class*num_part; i++) {
+		part_list[i].policy.reset(IPolicy::Factory(conf.cache_policy));
+		part_list[i].policy->reset(num_entry);
+	}
+}
 
-	for (auto it=lru_list.begin(); it!=lru_list.end(); it++) {
-		Entry *entry = *it;
-		if (not entry->isUsed()) { // If not used, touches and returns
-			lru_list.erase(it);
-			lru_list.push_back(entry);
-			entry->self = std::next(lru_list.rbegin()).base();
-			return lru_list.back();
-		}
+bool Cache::useEntry(Entry *entry) {
+	PolicyPart &part = partOf(entry);
+	std::lock_guard<std::mutex> lock(part.mtx); // thread-safe, only the part of the entry
+	std::lock_guard<std::mutex> entry_lock(entry->mtx);
+
+	if (!entry->isUsed())
+		part.policy->remove(entry); // Not a candidate while used
+	entry->setUsed();
+
+	bool prefetched = entry->prefetched;
+	unsetPrefetched(entry);
+	return prefetched;
+}
+
+void Cache::unuseEntry(Entry *entry) {
+	PolicyPart &part = partOf(entry);
+	std::lock_guard<std::mutex> lock(part.mtx); // thread-safe, only the part of the entry
+	std::lock_guard<std::mutex> entry_lock(entry->mtx);
+
+	entry->unsetUsed();
+	if (!entry->isUsed())
+		part.policy->insert(entry); // Candidate again
+}
+
+void Cache::unsetPrefetched(Entry *entry) {
+	// Note: the caller must hold 'entry->mtx'
+	if (entry->prefetched) {
+		entry->prefetched = false;
+		num_prefetched--;
 	}
-	assert(!"Reached end of 'list' without finding free LRU");
 }
 
-void Cache::makeLRU(Entry* entry) {
-	//std::unique_lock<std::mutex> lock(mtx_lru); // thread-safe
+void Cache::evict(Block *victim) {
+	// 'victim' is a copy of the old block, only linked to the entry when it was dirty
+	if (victim->entry == nullptr)
+		return;
 
-	lru_list.erase(entry->self);
-	lru_list.push_front(entry);
-	entry->self = lru_list.begin();
+	if (host.enabled()) // Demotes to the host tier, which writes to disk when full
+	{
+		attachHost(victim->entry,pinnedPtr());
+		victim->recv();
+		keepResult(victim);
+		auto demote = [&](const Key &key, void *data) {
+			if (write_queue.enabled()) { // Staged and written behind, the worker only copies the slot
+				Entry *stage = write_queue.acquire();
+				std::memcpy(stage->host_mem,data,unit_mem_size);
+				WriteJob job = {Block(key,unit_mem_size,DEPEND_UNKNOWN),stage,nullptr};
+				write_queue.push(job);
+				return;
+			}
+			Entry tmp(victim->entry->dev_mem,-1); // only 'host_mem' is accessed
+			tmp.host_mem = data;
+			Block old(key,unit_mem_size,DEPEND_UNKNOWN);
+			old.entry = &tmp;
+			IFile *file = getFile(key.node);
+			io_queue.run(file,[&]{ return old.store(file); });
+			clock.incr(STORED);
+		};
+		host.put(victim->key,victim->entry->host_mem,victim->size(),demote);
+		detachHost(victim->entry);
+	}
+	else if (write_queue.enabled()) // Staged and written behind
+	{
+		Entry *stage = write_queue.acquire();
+		attachHost(victim->entry,stage->host_mem);
+		victim->recv();
+		if (victim->entry->unified) // the entry is reused right away, its data is copied
+			std::memcpy(stage->host_mem,victim->entry->host_mem,victim->size());
+		keepResult(victim);
+		detachHost(victim->entry);
+		WriteJob job = {*victim,stage,nullptr};
+		write_queue.push(job);
+	}
+	else // Straight to disk
+	{
+		store(victim);
+	}
+	clock.incr(EVICTED);
+	clock.decr(NOT_STORED);
 }
 
-void Cache::evict(Block *old) {
-	if (old == nullptr)
+void Cache::prefetch(const Key &key) {
+	if (not conf.inmem_cache)
+		return; // Nothing to prefetch into
+
+	Shard &shard = shardOf(key);
+	std::unique_lock<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+	auto it = shard.blk_hash.find(key);
+	if (it == shard.blk_hash.end())
+		return; // Only existing blocks, a stale peeked job would bring discarded blocks back
+	Block *blk = it->second.get();
+
+	if (blk->entry != nullptr || blk->fixed || predictInput(blk))
+		return; // Already in memory (or being loaded), or no need for memory
+
+	if (num_prefetched >= prefetch_num_entry) {
+		lock.unlock();
+		adviseLoad(key); // Prefetched blocks can't take more entries
 		return;
-	if (old->entry == nullptr)
+	}
+
+	Entry *entry = getFree(classOf(blk)); // returns 'used', 'loading' and 'prefetched'
+	if (entry == nullptr) {
+		lock.unlock();
+		adviseLoad(key); // Blocks in the cache are never pushed out by prefetched ones, the page cache is warmed instead
 		return;
-	if (old->entry->isDirty()) {
-		old->entry->unsetDirty();
-		Block copy = *old;
-		old->entry = nullptr;
-		store(&copy);
-		clock.incr(EVICTED);
-		clock.decr(NOT_STORED);
-	} else {
-		old->entry = nullptr;
 	}
+
+	entry->block = blk;
+	blk->entry = entry;
+	lock.unlock(); // jobs retaining 'blk' will wait for the prefetcher
+
+	load(blk);
+	clock.incr(PREFETCHED);
+
+	entry->mtx.lock();
+	entry->unsetLoading();
+	entry->mtx.unlock();
+	unuseEntry(entry); // evictable again, unless some job retained it meanwhile
+	notifyLoaders(entry);
+}
+
+void Cache::adviseLoad(const Key &key) {
+	auto *bin_file = dynamic_cast<File<binary>*>( getFile(key.node) );
+	if (bin_file != nullptr)
+		bin_file->advise(key.coord); // Mapped files only, see binary::advise
+}
+
+bool Cache::isResident(const Key &key) {
+	if (not conf.inmem_cache)
+		return false; // Nothing stays resident
+	Shard &shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+	auto it = shard.blk_hash.find(key);
+	return it != shard.blk_hash.end() && (it->second->entry != nullptr || it->second->fixed);
+}
+
+std::string Cache::policyName() const {
+	std::unique_ptr<IPolicy> policy(IPolicy::Factory(conf.cache_policy));
+	return policy->name();
+}
+
+const Cache::ClassList& Cache::classList() const {
+	return class_list;
+}
+
+int Cache::batchLimit() const {
+	return num_batch;
+}
+
+const Cache::SpillList& Cache::spillList() const {
+	return spill_list;
+}
+
+bool Cache::writeBehind() {
+	WriteJob job;
+	if (!write_queue.pop(job))
+		return false; // Closed and drained
+
+	TimedRegion region(clock,WBEHIND);
+	Block &blk = job.block;
+	bool written = false;
+
+	if (job.entry != nullptr) // Receives the data, then releases the entry
+	{
+		attachHost(job.entry,job.stage->host_mem);
+		blk.entry = job.entry;
+		blk.recv();
+		if (job.entry->unified) { // Zero-copy, written straight from the entry
+			blk.store(getFile(blk.key.node));
+			keepResult(&blk);
+			written = true;
+		}
+		detachHost(job.entry);
+
+		job.entry->mtx.lock();
+		job.entry->unsetDirty();
+		job.entry->unsetWriting();
+		job.entry->mtx.unlock();
+		unuseEntry(job.entry);
+		notifyWriters(job.entry);
+	}
+
+	if (!written) {
+		blk.entry = job.stage;
+		blk.store(getFile(blk.key.node));
+		keepResult(&blk);
+	}
+	clock.incr(STORED);
+
+	write_queue.done(job);
+	return true;
+}
+
+void Cache::drainWrites() {
+	write_queue.close(); // the Writers exit once the queue is empty
+}
+
+bool Cache::serveIO() {
+	return io_queue.serve();
+}
+
+void Cache::closeIO() {
+	io_queue.close(); // the I/O threads exit once the file queues are empty
+}
+
+int Cache::classOf(const Block *block) const {
+	for (int k=0; k<class_list.size(); k++)
+		if (class_list[k].block_size == block->size())
+			return k;
+	assert(!"Block size without size class");
+	return -1;
+}
+
+void* Cache::pinnedPtr() {
+	return unified ? nullptr : pinned_ptr[Tid.proj()]; // No pinned buffers in zero-copy mode
+}
+
+void Cache::attachHost(Entry *entry, void *host_mem) {
+	if (!entry->unified) // Unified entries keep their own mapped memory
+		entry->host_mem = host_mem;
+}
+
+void Cache::detachHost(Entry *entry) {
+	if (!entry->unified)
+		entry->host_mem = nullptr;
+}
+
+bool Cache::isReusable(Block *block) {
+	return result.enabled() && !block->fixed && result.signOf(block->key.node) != 0;
+}
+
+void Cache::keepResult(Block *block) {
+	// Note: the data must be in 'block->entry->host_mem' already
+	if (isReusable(block))
+		result.put(block->key,block->entry->host_mem,block->size());
+}
+
+void Cache::saveResult(Block *block) {
+	// Note: 'block' must be linked to a used entry, its data is received only if not kept yet
+	if (!isReusable(block) || result.contains(block->key))
+		return;
+	attachHost(block->entry,pinnedPtr());
+	block->recv();
+	result.put(block->key,block->entry->host_mem,block->size());
+	detachHost(block->entry);
+}
+
+bool Cache::reuseOutputs(const BlockList &out_blk) {
+	if (out_blk.empty())
+		return false;
+	for (auto b : out_blk)
+		if (b->holdtype() != HOLD_N || !isReusable(b))
+			return false; // Scalars and non-reusable nodes are always computed
+
+	for (auto b : out_blk) {
+		attachHost(b->entry,pinnedPtr());
+		bool hit = result.get(b->key,b->entry->host_mem,b->size());
+		if (hit)
+			b->send();
+		detachHost(b->entry);
+		if (!hit)
+			return false; // The job is computed as usual, overwriting the reused blocks
+	}
+	clock.incr(REUSED);
+	return true;
+}
+
+bool Cache::predictInput(Block *block) {
+	// Note: the caller holds the block's shard, the file stats are read-only during the evaluation
+	if (isTemporal(block->key.node) || block->key.node->streamdir() != IN)
+		return false; // Only input files have stats before being read
+	return getFile(block->key.node)->predictBlock(*block);
+}
+
+bool Cache::isTemporal(Node *node) {
+	return dynamic_cast<IONode*>(node) == nullptr; // Only IONodes have their own file
 }
 
 IFile* Cache::getFile(Node *node) { // @
@@ -524,6 +1098,7 @@ IFile* Cache::getFile(Node *node) { // @
 	IONode *ionode = dynamic_cast<IONode*>(node);
 	if (ionode != nullptr) return ionode->file();
 	// All other nodes requires a temporal file
+	std::lock_guard<std::mutex> lock(mtx_file); // thread-safe
 	auto it = file_hash.find(node);
 	if (it == file_hash.end())
 		it = file_hash.insert({node,IFile::Factory(node)}).first;
@@ -534,23 +1109,19 @@ void Cache::store(Block *block) {
 	assert(block->holdtype() == HOLD_N);
 
 	IFile *file = getFile(block->key.node);
-	mtx.unlock(); // No thread-safe, to achieve concurrent IO
 
-	block->entry->host_mem = pinned_ptr[Tid.proj()]; 
+	attachHost(block->entry,pinnedPtr());
 	block->recv();
-	block->store(file);
-	block->entry->host_mem = nullptr;
+	io_queue.run(file,[&]{ return block->store(file); });
+	keepResult(block);
+	detachHost(block->entry);
 	clock.incr(STORED);
-
-	mtx.lock(); // thread-safe again
 }
 
 void Cache::storeScalar(Block *block) {
 	assert(block->holdtype() == HOLD_1);
 
-	mtx.lock(); // thread-safe
 	IFile *file = getFile(block->key.node);
-	mtx.unlock();
 
 	block->store(file);
 }
@@ -559,15 +1130,22 @@ void Cache::load(Block *block) {
 	assert(block->holdtype() == HOLD_N);
 
 	IFile *file = getFile(block->key.node);
-	mtx.unlock(); // No thread-safe, to achieve concurrent IO
 
-	block->entry->host_mem = pinned_ptr[Tid.proj()];
-	block->load(file);
+	attachHost(block->entry,pinnedPtr());
+	if (isTemporal(block->key.node) && host.take(block->key,block->entry->host_mem,block->size())) {
+		// Promoted from the host tier, the device holds now the only copy
+		std::lock_guard<std::mutex> lock(block->entry->mtx);
+		block->entry->setDirty();
+		clock.incr(NOT_STORED);
+	} else if (!isReusable(block) || !result.get(block->key,block->entry->host_mem,block->size())) {
+		// Only after take() misses: a slot demoted while take() waited on it is already queued, see HostCache::put
+		write_queue.waitForKey(block->key); // the file is outdated till then
+		io_queue.run(file,[&]{ return block->load(file); });
+		keepResult(block);
+	}
 	block->send();
-	block->entry->host_mem = nullptr;
+	detachHost(block->entry);
 	clock.incr(LOADED);
-
-	mtx.lock(); // thread-safe again
 }
 
 void Cache::loadScalar(Block *block) {
@@ -580,9 +1158,7 @@ void Cache::loadScalar(Block *block) {
 		return;
 	}
 
-	mtx.lock(); // thread-safe
 	IFile *file = getFile(block->key.node);
-	mtx.unlock();
 
 	block->load(file);
 }
@@ -590,31 +1166,33 @@ void Cache::loadScalar(Block *block) {
 void Cache::loadOut(Block *block) { // @@ load_out is not yet needed
 	return; // @@
 	
-	if (first_time.find(block->key) == first_time.end()) {
-		first_time.insert(block->key);
-		return; // @ does not load the first request of an Output-Block
+	{
+		std::lock_guard<std::mutex> lock(mtx_file); // thread-safe
+		if (first_time.find(block->key) == first_time.end()) {
+			first_time.insert(block->key);
+			return; // @ does not load the first request of an Output-Block
+		}
 	}
 	load(block);
 }
 
 void Cache::waitForLoader(Entry *entry) {
-	std::unique_lock<std::mutex> lock(mtx,std::adopt_lock);
-	cv_load.wait(lock,[&]{ return !entry->isLoading(); }); // exit-condition = !loading
-	lock.release();
+	std::unique_lock<std::mutex> lock(entry->mtx);
+	entry->cv.wait(lock,[&]{ return !entry->isLoading(); }); // exit-condition = !loading
 }
 
-void Cache::notifyLoaders() {
-	cv_load.notify_all();
+void Cache::notifyLoaders(Entry *entry) {
+	entry->cv.notify_all(); // only wakes the jobs waiting on this entry
 }
 
 void Cache::waitForWriter(Entry *entry) {
-	std::unique_lock<std::mutex> lock(mtx,std::adopt_lock);
-	cv_write.wait(lock,[&]{ return !entry->isWriting(); }); // exit-condition = !writing
-	lock.release();
+	std::unique_lock<std::mutex> lock(entry->mtx);
+	entry->cv.wait(lock,[&]{ return !entry->isLoading() && !entry->isWriting(); }); // exit-condition = !loading && !writing
+	entry->setWriting(); // still under lock, next writers will wait
 }
 
-void Cache::notifyWriters() {
-	cv_write.notify_all();
+void Cache::notifyWriters(Entry *entry) {
+	entry->cv.notify_all(); // only wakes the jobs waiting on this entry
 }
 
 } } // namespace map::detail
@@ -3,6 +3,16 @@
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
  * Note: depend=-1 means the block wont be discarded, useful when its future use is unknown (eg Spreading)
+ * Note: the directory is striped in shards by 'key_hash', each shard with its own lock
+ * Note: lock order is shard --> policy part --> entry, other shards are only try-locked (see getVictim)
+ * Note: entries enter / leave the replacement policy when their 'used' count drops to / leaves 0 (see useEntry)
+ * Note: blocks only replace entries of their own size class, so B8 masks do not waste the memory of F64 entries
+ *
+ * Note: dirty blocks evicted from the device are demoted to the HostCache tier, and only then to disk
+ * Note: on CPU devices the chunks are mapped once (zero-copy), the files read / write the entries directly
+ * Note: writes to disk are queued in the WriteQueue and done by the Writers, unless conf.num_writers == 0
+ * Note: blocks passing through host memory are also kept in the ResultCache, later evaluations reuse them
+ * Note: the file reads / writes of the workers are submitted to the IOQueue, the I/O threads serve them
  *
  * TODO: There should be 1 cache per physical memory (Dev mem, Host mem, SSD mem, HDD mem)
  */
@@ -12,15 +22,22 @@
 
 #include "Entry.hpp"
 #include "Block.hpp"
+#include "Policy.hpp"
+#include "HostCache.hpp"
+#include "WriteQueue.hpp"
+#include "IOQueue.hpp"
+#include "ResultCache.hpp"
 #include "Config.hpp"
 #include <vector>
-#include <list>
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <tuple>
 
 
 namespace map { namespace detail {
@@ -30,6 +47,38 @@ class Clock; // Forward declaration
 
 class Cache
 {
+	typedef std::unordered_map<Key,std::unique_ptr<Block>,key_hash> BlockHash;
+	typedef std::vector<std::tuple<int,size_t,size_t>> SpillList; // Node id, raw bytes, encoded bytes
+
+  public:
+	/*
+	 * Entries of the same block size, the memory of each block is proportional to its own data type
+	 */
+	struct SizeClass {
+		size_t block_size; //!< Bytes of the blocks, prod(blocksize) * sizeOf(datatype)
+		size_t entry_size; //!< Bytes of the entries, 'block_size' rounded up to the sub-buffer alignment
+		int num_entry; //!< Entries carved for this class
+	};
+	typedef std::vector<SizeClass> ClassList;
+
+  private:
+
+	/*
+	 * Stripe of the cache directory
+	 */
+	struct Shard {
+		std::mutex mtx; //!< Protects 'blk_hash' and the Block <--> Entry links of its blocks
+		BlockHash blk_hash; //!< Hashed cache directory (only this stripe)
+	};
+
+	/*
+	 * Part of the replacement policy of a size class, entries are spread by id
+	 */
+	struct PolicyPart {
+		std::mutex mtx; //!< Protects 'policy'
+		std::unique_ptr<IPolicy> policy; //!< Unused entries of this part
+	};
+
   private:
 	Program &prog; // Aggregate
 	Clock &clock; // Aggregate
@@ -37,15 +86,27 @@ class Cache
 
 	cl_mem scalar_page; //!< Page of device memory where scalars reside
 	std::vector<cl_mem> chunk_list; //!< Chunks of device memory
-	std::vector<Entry> entry_list; //!< Entry memory allocator
-	std::list<Entry*> lru_list; //!< Least Recently Used LRU linked list
-	std::unordered_map<Key,std::unique_ptr<Block>,key_hash> blk_hash; //!< Hashed cache directory
+	std::vector<char*> chunk_ptr; //!< Chunks mapped once in host memory, only when 'unified'
+	bool unified; //!< Zero-copy mode, the device shares the host memory (e.g. CPUs)
+	std::deque<Entry> entry_list; //!< Entry memory allocator
+	ClassList class_list; //!< Size classes, from the largest
+	std::unique_ptr<PolicyPart[]> part_list; //!< Replacement policy of each size class, in 'num_part' parts
+	int num_part; //!< Parts of the policy per size class
+	HostCache host; //!< Host memory tier, between the device entries and the files
+	WriteQueue write_queue; //!< Dirty blocks waiting for the Writers
+	IOQueue io_queue; //!< File reads / writes of the workers, served by the I/O threads
+	ResultCache result; //!< Blocks kept across evaluations, keyed by node signature
+	std::unique_ptr<Shard[]> shard_list; //!< Sharded cache directory
+	int shard_mask;
 	
 	std::vector<cl_mem> pinned_mem;
 	std::vector<void*> pinned_ptr;
 
-	std::mutex mtx, mtx_blk; //, mtx_lru, mtx_load, mtx_write;
-	std::condition_variable cv_load, cv_write; //cv_evict
+	std::mutex mtx_file;
+
+	std::atomic<int> num_prefetched; //!< Entries holding prefetched blocks not yet retained
+	int prefetch_num_entry; //!< Limit of 'num_prefetched'
+	int num_batch; //!< Jobs whose blocks a worker retains at once, see Worker::work
 
 	size_t unit_mem_size;
 	BlockSize unit_block_size;
@@ -53,6 +114,7 @@ class Cache
 
 	std::unordered_map<Node*,IFile*> file_hash; // @
 	std::unordered_set<Key,key_hash> first_time; // @ avoids partial-writes to load the 'first time'
+	SpillList spill_list; //!< Bytes spilled to the temporal files during the last evaluation
 
   public:
 	Cache(Program &prog, Clock &clock, Config &conf);
@@ -71,30 +133,65 @@ class Cache
 	void retainOutputBlocks(const OutKeyList &out_key, BlockList &out_blk);
 	void releaseInputBlocks(BlockList &in_blk);
 	void releaseOutputBlocks(BlockList &out_blk, const OutKeyList &out_key);
+	void skipInputBlocks(const InKeyList &in_key);
+
+	void prefetch(const Key &key);
+	bool isResident(const Key &key);
+	std::string policyName() const;
+	const SpillList& spillList() const;
+	const ClassList& classList() const;
+	int batchLimit() const;
+
+	bool writeBehind();
+	void drainWrites();
+	bool serveIO();
+	void closeIO();
+
+	bool reuseOutputs(const BlockList &out_blk);
 
   private:
+	Shard& shardOf(const Key &key);
+	PolicyPart& partOf(const Entry *entry);
+	void resetParts(int num_class, int num_entry);
+	Block* findBlock(Shard &shard, const Key &key, int depend);
+	void clearShards();
+
   	Block* retainEntryForInput(const Key &k);
 	Block* retainEntryForOutput(const Key &k, int depend);
 	void releaseEntryFromInput(Block *blk);
+	bool notifyInput(Shard &shard, Block *blk, Block &saved);
 	void releaseEntryFromOutput(Block *blk);
 
-	Entry* getLRU();
-	void makeLRU(Entry *entry);
-	void evict(Block *block);
+	Entry* getVictim(Shard &shard, Block &victim, int cls);
+	Entry* getFree(int cls);
+	int classOf(const Block *block) const;
+	bool useEntry(Entry *entry);
+	void unuseEntry(Entry *entry);
+	void unsetPrefetched(Entry *entry);
+	void evict(Block *victim);
 	IFile* getFile(Node *node); // @
+	bool isTemporal(Node *node);
+	bool predictInput(Block *block);
+	void* pinnedPtr();
+	void attachHost(Entry *entry, void *host_mem);
+	void detachHost(Entry *entry);
+	bool isReusable(Block *block);
+	void keepResult(Block *block);
+	void saveResult(Block *block);
 
 	void load(Block *block);
 	void loadScalar(Block *block);
 	void loadOut(Block *block); // @
+	void adviseLoad(const Key &key);
 
 	void store(Block *block);
 	void storeScalar(Block *block);
 
 	void waitForLoader(Entry *entry);
-	void notifyLoaders();
+	void notifyLoaders(Entry *entry);
 
 	void waitForWriter(Entry *entry);
-	void notifyWriters();
+	void notifyWriters(Entry *entry);
 };
 
 } } // namespace map::detail
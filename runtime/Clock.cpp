@@ -27,7 +27,7 @@ void Clock::resize() {
 		rank[m].resize(conf.num_devices);
 
 		for (int d=0; d<conf.num_devices; d++)
-			rank[m][d].resize(conf.num_ranks);
+			rank[m][d].resize(conf.num_ranks + conf.num_prefetchers + conf.num_writers + conf.num_io_threads); // I/O threads go after the workers
 	}
 }
 
@@ -99,7 +99,7 @@ void Clock::helper2(int enu, ThreadId id, std::function<void(TimerCounter&, int)
 	
 	M = (id.mch() == ID_NONE) ? 0 : (id.mch() == ID_ALL) ? conf.num_machines : id.mch()+1;
 	D = (id.dev() == ID_NONE) ? 0 : (id.dev() == ID_ALL) ? conf.num_devices : id.mch()+1;
-	R = (id.rnk() == ID_NONE) ? 0 : (id.rnk() == ID_ALL) ? conf.num_ranks : id.mch()+1;
+	R = (id.rnk() == ID_NONE) ? 0 : (id.rnk() == ID_ALL) ? conf.num_ranks + conf.num_prefetchers + conf.num_writers + conf.num_io_threads : id.mch()+1;
 	m = (id.mch() == ID_ALL) ? 0 : (id.mch() == ID_NONE) ? R : id.mch();
 	d = (id.dev() == ID_ALL) ? 0 : (id.dev() == ID_NONE) ? D : id.dev();
 	r = (id.rnk() == ID_ALL) ? 0 : (id.rnk() == ID_NONE) ? R : id.rnk();
@@ -142,7 +142,7 @@ void Clock::helper3(int enu, ThreadId id, std::function<void(TimerCounter&, Time
 	
 	M = (id.mch() == ID_NONE) ? 0 : (id.mch() == ID_ALL) ? conf.num_machines : id.mch()+1;
 	D = (id.dev() == ID_NONE) ? 0 : (id.dev() == ID_ALL) ? conf.num_devices : id.mch()+1;
-	R = (id.rnk() == ID_NONE) ? 0 : (id.rnk() == ID_ALL) ? conf.num_ranks : id.mch()+1;
+	R = (id.rnk() == ID_NONE) ? 0 : (id.rnk() == ID_ALL) ? conf.num_ranks + conf.num_prefetchers + conf.num_writers + conf.num_io_threads : id.mch()+1;
 	m = (id.mch() == ID_ALL) ? 0 : (id.mch() == ID_NONE) ? R : id.mch();
 	d = (id.dev() == ID_ALL) ? 0 : (id.dev() == ID_NONE) ? D : id.dev();
 	r = (id.rnk() == ID_ALL) ? 0 : (id.rnk() == ID_NONE) ? R : id.rnk();
@@ -22,9 +22,11 @@ namespace map { namespace detail {
 // Enum
 
 enum TimerEnum { NONE_TIMER, OVERALL, DEVICES, EVAL, ALLOC_C, FUSION, TASKIF, CODGEN, COMPIL, ADD_JOB, ALLOC_E, EXEC, FREE_E, FREE_C,
-				 GET_JOB, LOAD, COMPUTE, STORE, NOTIFY, READ, SEND, KERNEL, RECV, WRITE, N_TIMER };
+				 GET_JOB, LOAD, COMPUTE, STORE, NOTIFY, PREFETCH, WBEHIND, BACKPRES, READ, SEND, KERNEL, RECV, WRITE, N_TIMER };
 
-enum CounterEnum { NONE_COUNTER, LOADED, STORED, COMPUTED, DISCARDED, EVICTED, NOT_LOADED, NOT_STORED, NOT_COMPUTED, N_COUNTER };
+enum CounterEnum { NONE_COUNTER, LOADED, STORED, COMPUTED, DISCARDED, EVICTED, NOT_LOADED, NOT_STORED, NOT_COMPUTED,
+				   PREFETCHED, PREFETCH_HIT, PREFETCH_MISS, REPLACED,
+				   HOST_HIT, HOST_MISS, HOST_EVICTED, RESULT_HIT, RESULT_MISS, REUSED, STOLEN, AFFINITY, N_COUNTER };
 
 /*
  *
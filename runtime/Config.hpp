@@ -13,6 +13,8 @@
 
 namespace map { namespace detail {
 
+enum PolicyType { NONE_POLICY, LRU_POLICY, COORD_POLICY, N_POLICY }; // Cache replacement policies
+
 struct Config {
 	//// Fixed options, requires recompilation
 	const bool debug = true;
@@ -21,6 +23,15 @@ struct Config {
 	const bool inmem_cache = true; // Activates in-memory caching
 	const bool compil_cache = true; // Activates compilation cache
 	const bool prediction = true; // Activates predicton
+	const bool zero_copy = true; // Activates unified host memory on CPU devices (no send / recv)
+	const bool task_ranking = true; // Orders the tasks by their critical path, see Program::rank
+	const char *profile_path = "profile.txt"; // Kernel times of earlier runs, in the per-user directory of Persist.hpp
+	const bool disk_cache = true; // Activates the on-disk compilation cache
+	const char *kernel_path = "kernels"; // Kernel binaries of earlier runs, in the per-user directory of Persist.hpp
+	const bool cpu_vector = true; // Explicit vector code for the local kernels of CPU devices, see CpuLocalSkeleton.hpp
+	const bool autotuning = false; // Benchmarks candidate group sizes during the first evaluation, see Tuning.hpp
+	const char *tuning_path = "tuning.txt"; // Group sizes tuned by earlier runs, in the per-user directory
+	const int uring_depth = 256; // Entries of the submission ring, see ioengine.hpp
 
 	// Max
 	const int max_num_machines = 1;
@@ -29,9 +40,22 @@ struct Config {
 	const int max_num_workers = max_num_machines * max_num_devices * max_num_ranks;
 	const size_t max_cache_size = (size_t)1024*1024*1024 * 16; // GB
 	const size_t max_cache_chunk = (size_t)1024*1024*1024 * 1; // GB
+	const size_t max_host_cache_size = (size_t)1024*1024*1024 * 256; // GB
 	const int max_block_size = 1024*1024*sizeof(double); // 8 MB
 	const int max_in_block = 16;
 	const int max_out_block = 16;
+	const int max_num_prefetchers = 4;
+	const int max_prefetch_depth = 64;
+	const int max_num_writers = 8;
+	const int max_num_io_threads = 32;
+	const int max_file_queue_depth = 64;
+	const size_t max_write_buffer = (size_t)1024*1024*1024 * 16; // GB
+	const size_t max_result_cache_size = (size_t)1024*1024*1024 * 256; // GB
+	const int max_affinity_window = 64;
+	const int max_batch_size = 64;
+	const int max_batch_block = 256*1024; // Only blocks up to 256 KB are batched
+	const int max_pipeline_depth = 8;
+	const int max_num_compilers = 32;
 
 	// Min
 	const int min_num_machines = 1;
@@ -40,9 +64,21 @@ struct Config {
 	const int min_num_workers = min_num_machines * min_num_devices * min_num_ranks;
 	const size_t min_cache_size =  max_block_size * 16; // @ difficult to give a static number
 	const size_t min_cache_chunk = (size_t)1024*1024 * 64; // MB
+	const size_t min_host_cache_size = 0; // deactivates the host tier
 	const int min_block_size = 64*64*sizeof(bool); // 4 KB (page size)
 	const int min_in_block = 0;
 	const int min_out_block = 1;
+	const int min_num_prefetchers = 0;
+	const int min_prefetch_depth = 0;
+	const int min_num_writers = 0; // synchronous writes
+	const int min_num_io_threads = 0; // the workers read / write themselves
+	const int min_file_queue_depth = 1;
+	const size_t min_write_buffer = 0;
+	const size_t min_result_cache_size = 0; // deactivates the reuse across evaluations
+	const int min_affinity_window = 1; // static order only
+	const int min_batch_size = 1; // one job per kernel launch
+	const int min_pipeline_depth = 1; // load, compute and store in sequence
+	const int min_num_compilers = 1;
 
 	// Default
 	const int def_num_machines = 1;
@@ -50,8 +86,29 @@ struct Config {
 	const int def_num_ranks = 16;
 	const size_t def_cache_size = (size_t)1024*1024 * (512*5); // @ 512*7 MB @@
 	const size_t def_cache_chunk = (size_t)1024*1024 * 256; // @ 256 MB
+	const size_t def_host_cache_size = (size_t)1024*1024*1024 * 2; // @ 2 GB, host tier under the device cache
 	const size_t def_scalar_size = sizeof(double) * max_out_block * max_num_ranks;
 	const int def_block_size = 128*128*sizeof(float);
+	const int def_cache_num_shard = 64; // Stripes of the cache directory, power of 2
+	const int def_policy_num_part = 8; // Parts of the replacement policy of each size class, each with its own lock
+	const int def_num_prefetchers = 1; // I/O threads per device, loading blocks ahead of the workers
+	const int def_prefetch_depth = 8; // Number of upcoming jobs looked ahead
+	const double def_prefetch_limit = 0.25; // Max share of entries holding prefetched but unused blocks
+	const PolicyType def_cache_policy = LRU_POLICY;
+	const bool def_spill_compress = true; // Encodes the blocks spilled to temporal files, on the Writers / I/O threads
+	const int def_num_writers = 2; // I/O threads per device, writing dirty blocks behind the workers
+	const int def_num_io_threads = 4; // I/O threads per device, serving the reads / writes of the workers
+	const int def_file_queue_depth = 4; // Requests of one file served at once
+	const size_t def_write_buffer = (size_t)1024*1024 * 256; // @ 256 MB of staged blocks, then back-pressure
+	const size_t def_result_cache_size = min_result_cache_size; // Off, blocks reused across evaluations, see ResultCache.hpp
+	const int def_affinity_window = 4; // Ready jobs scored by the residency of their inputs
+	const int def_batch_size = 8; // Max jobs of the same task per kernel launch, tuned per task below this
+	const int def_pipeline_depth = 2; // Stages (jobs or batches) a worker keeps in flight
+	const int def_num_compilers = 4; // Threads building the kernels while the workers run the tasks already built
+	const bool def_uring_io = true; // io_uring engine for the binary files when built with LIBURING, see ioengine.hpp
+	const bool def_direct_io = false; // O_DIRECT for the page-aligned blocks of the binary files
+	const bool def_mmap_io = false; // Maps the binary files, blocks are copied from / to the mapping, see binary.hpp
+	const double def_job_cost = 0.001; // @ seconds per job of the versions without profile
 
 	// Limits
 	const int hard_nodes_limit = 1050; // @ 1024
@@ -64,8 +121,28 @@ struct Config {
 	int num_ranks = def_num_ranks;
 	size_t cache_size = def_cache_size;
 	size_t cache_chunk = def_cache_chunk;
+	size_t host_cache_size = def_host_cache_size;
 	size_t scalar_size = def_scalar_size;
 	int block_size = def_block_size;
+	int cache_num_shard = def_cache_num_shard;
+	int policy_num_part = def_policy_num_part;
+	int num_prefetchers = def_num_prefetchers;
+	int prefetch_depth = def_prefetch_depth;
+	double prefetch_limit = def_prefetch_limit;
+	PolicyType cache_policy = def_cache_policy;
+	bool spill_compress = def_spill_compress;
+	int num_writers = def_num_writers;
+	size_t write_buffer = def_write_buffer;
+	int num_io_threads = def_num_io_threads;
+	int file_queue_depth = def_file_queue_depth;
+	size_t result_cache_size = def_result_cache_size;
+	int affinity_window = def_affinity_window;
+	int batch_size = def_batch_size;
+	int pipeline_depth = def_pipeline_depth;
+	int num_compilers = def_num_compilers;
+	bool uring_io = def_uring_io;
+	bool direct_io = def_direct_io;
+	bool mmap_io = def_mmap_io;
 	
 	// Inferred
 	int num_workers = num_machines * num_devices * num_ranks;
@@ -79,6 +156,21 @@ struct Config {
 	void setNumDevices(int num_devices);
 	void setNumRanks(int num_ranks);
 	void setBlockSize(int block_size);
+	void setNumPrefetchers(int num_prefetchers);
+	void setPrefetchDepth(int prefetch_depth);
+	void setCachePolicy(PolicyType cache_policy);
+	void setHostCacheSize(size_t host_cache_size);
+	void setNumWriters(int num_writers);
+	void setWriteBuffer(size_t write_buffer);
+	void setNumIOThreads(int num_io_threads);
+	void setFileQueueDepth(int file_queue_depth);
+	void setResultCacheSize(size_t result_cache_size);
+	void setAffinityWindow(int affinity_window);
+	void setBatchSize(int batch_size);
+	void setPipelineDepth(int pipeline_depth);
+	void setNumCompilers(int num_compilers);
+	void setIOEngine(bool uring_io, bool direct_io);
+	void setMmapIO(bool mmap_io);
 };
 
 inline void Config::setNumMachines(int num_machines) {
@@ -106,6 +198,80 @@ inline void Config::setBlockSize(int block_size) {
 	this->chunk_num_entry = cache_chunk / block_size;
 }
 
+inline void Config::setNumPrefetchers(int num_prefetchers) {
+	assert(num_prefetchers >= min_num_prefetchers && num_prefetchers <= max_num_prefetchers);
+	this->num_prefetchers = num_prefetchers;
+}
+
+inline void Config::setPrefetchDepth(int prefetch_depth) {
+	assert(prefetch_depth >= min_prefetch_depth && prefetch_depth <= max_prefetch_depth);
+	this->prefetch_depth = prefetch_depth;
+}
+
+inline void Config::setCachePolicy(PolicyType cache_policy) {
+	assert(cache_policy > NONE_POLICY && cache_policy < N_POLICY);
+	this->cache_policy = cache_policy;
+}
+
+inline void Config::setHostCacheSize(size_t host_cache_size) {
+	assert(host_cache_size >= min_host_cache_size && host_cache_size <= max_host_cache_size);
+	this->host_cache_size = host_cache_size;
+}
+
+inline void Config::setNumWriters(int num_writers) {
+	assert(num_writers >= min_num_writers && num_writers <= max_num_writers);
+	this->num_writers = num_writers;
+}
+
+inline void Config::setWriteBuffer(size_t write_buffer) {
+	assert(write_buffer >= min_write_buffer && write_buffer <= max_write_buffer);
+	this->write_buffer = write_buffer;
+}
+
+inline void Config::setNumIOThreads(int num_io_threads) {
+	assert(num_io_threads >= min_num_io_threads && num_io_threads <= max_num_io_threads);
+	this->num_io_threads = num_io_threads;
+}
+
+inline void Config::setFileQueueDepth(int file_queue_depth) {
+	assert(file_queue_depth >= min_file_queue_depth && file_queue_depth <= max_file_queue_depth);
+	this->file_queue_depth = file_queue_depth;
+}
+
+inline void Config::setResultCacheSize(size_t result_cache_size) {
+	assert(result_cache_size >= min_result_cache_size && result_cache_size <= max_result_cache_size);
+	this->result_cache_size = result_cache_size;
+}
+
+inline void Config::setAffinityWindow(int affinity_window) {
+	assert(affinity_window >= min_affinity_window && affinity_window <= max_affinity_window);
+	this->affinity_window = affinity_window;
+}
+
+inline void Config::setBatchSize(int batch_size) {
+	assert(batch_size >= min_batch_size && batch_size <= max_batch_size);
+	this->batch_size = batch_size;
+}
+
+inline void Config::setPipelineDepth(int pipeline_depth) {
+	assert(pipeline_depth >= min_pipeline_depth && pipeline_depth <= max_pipeline_depth);
+	this->pipeline_depth = pipeline_depth;
+}
+
+inline void Config::setNumCompilers(int num_compilers) {
+	assert(num_compilers >= min_num_compilers && num_compilers <= max_num_compilers);
+	this->num_compilers = num_compilers;
+}
+
+inline void Config::setIOEngine(bool uring_io, bool direct_io) { // Note: the engine is created by the first binary file
+	this->uring_io = uring_io;
+	this->direct_io = direct_io;
+}
+
+inline void Config::setMmapIO(bool mmap_io) { // Note: taken by the binary files opened afterwards
+	this->mmap_io = mmap_io;
+}
+
 } } // namespace map::detail
 
 #endif
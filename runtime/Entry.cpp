@@ -2,6 +2,7 @@
  * @file	Entry.hpp 
  * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: the setters / getters do not lock, the caller is expected to hold 'mtx'
  */
 
 #include "Entry.hpp"
@@ -10,14 +11,22 @@
 
 namespace map { namespace detail {
 
-Entry::Entry(cl_mem dev_mem)
-	: dev_mem(dev_mem)
+Entry::Entry(cl_mem dev_mem, int id)
+	: id(id)
+	, cls(0)
+	, dev_mem(dev_mem)
+	, chunk(nullptr)
+	, offset(0)
 	, host_mem(nullptr)
+	, unified(false)
 	, block(nullptr)
 	, used(0)
 	, dirty(false)
 	, loading(false)
 	, writing(false)
+	, prefetched(false)
+	, mtx()
+	, cv()
 { }
 
 void Entry::setDirty() {
@@ -2,6 +2,10 @@
  * @file	Entry.hpp 
  * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: the state flags (used, dirty, loading, writing) are protected by the entry's own 'mtx'
+ * Note: 'unified' entries have 'host_mem' permanently mapped to 'dev_mem', files read / write there directly
+ * Note: 'chunk' + 'offset' locate 'dev_mem' in its chunk, batched kernels address the entries that way
+ *
  * TODO: is 'host_mem' necessary?
  */
 
@@ -9,6 +13,8 @@
 #define MAP_RUNTIME_ENTRY_HPP_
 
 #include "../cle/OclEnv.hpp"
+#include <mutex>
+#include <condition_variable>
 
 
 namespace map { namespace detail {
@@ -17,7 +23,9 @@ struct Block; // forward declaration
 
 struct Entry {	
   // Constructors & methods
-	Entry(cl_mem dev_mem);
+	Entry(cl_mem dev_mem, int id);
+	Entry(const Entry&) = delete;
+	Entry& operator=(const Entry&) = delete;
 
 	void setDirty();
 	void unsetDirty();
@@ -33,12 +41,20 @@ struct Entry {
 	bool isWriting();
 
   // Variables
-	std::list<Entry*>::iterator self;
+	int id; //!< Index in the cache, used by the replacement policy
+	int cls; //!< Size class in the cache, see Cache::SizeClass
 	cl_mem dev_mem;
+	cl_mem chunk; //!< Chunk holding the subbuffer 'dev_mem'
+	size_t offset; //!< Bytes from the start of 'chunk'
 	void *host_mem;
+	bool unified; //!< 'host_mem' maps 'dev_mem', no send / recv needed
 	Block *block;
 	char used;
 	bool dirty, loading, writing;
+	bool prefetched; //!< Loaded ahead of time, not yet retained by any job
+
+	std::mutex mtx; //!< Protects the state flags
+	std::condition_variable cv; //!< Wakes the jobs waiting on this entry only
 };
 
 } } // namespace map::detail
@@ -0,0 +1,150 @@
+/**
+ * @file    HostCache.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: copies are done outside the lock, 'busy' slots keep the other threads waiting meanwhile
+ */
+
+#include "HostCache.hpp"
+#include "Clock.hpp"
+#include <cstring>
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+HostCache::HostCache(Clock &clock, Config &conf)
+	: clock(clock)
+	, conf(conf)
+	, unit_mem_size(0)
+{ }
+
+HostCache::~HostCache() { }
+
+void HostCache::allocSlots(size_t unit_mem_size) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	this->unit_mem_size = unit_mem_size;
+
+	int num_slot = (unit_mem_size > 0) ? conf.host_cache_size / unit_mem_size : 0;
+	if (num_slot == 0)
+		return; // Host tier deactivated
+
+	// Pages are not touched until blocks are demoted
+	memory = std::unique_ptr<char[]>(new char[num_slot*unit_mem_size]);
+	slot_list.resize(num_slot);
+	for (int i=0; i<num_slot; i++) {
+		slot_list[i].data = memory.get() + i*unit_mem_size;
+		slot_list[i].busy = false;
+		free_list.push_back(i);
+	}
+}
+
+void HostCache::freeSlots() {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	slot_hash.clear();
+	lru_list.clear();
+	free_list.clear();
+	slot_list.clear();
+	memory.reset();
+}
+
+bool HostCache::enabled() const {
+	return !slot_list.empty();
+}
+
+int HostCache::waitForSlot(std::unique_lock<std::mutex> &lock, const Key &key) {
+	// Note: the caller must hold 'lock'. Returns the slot of 'key' once it is not busy, -1 if not found
+	while (true) {
+		auto it = slot_hash.find(key);
+		if (it == slot_hash.end())
+			return -1;
+		if (!slot_list[it->second].busy)
+			return it->second;
+		cv.wait(lock);
+	}
+}
+
+void HostCache::put(const Key &key, const void *src, size_t size, DemoteFunction demote) {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	int i = waitForSlot(lock,key);
+	if (i != -1) // Outdated copy of the same block, overwritten
+	{
+		lru_list.erase(slot_list[i].self);
+	}
+	else if (!free_list.empty()) // Free slot
+	{
+		i = free_list.back();
+		free_list.pop_back();
+	}
+	else // Full, the least recently demoted block goes to disk
+	{
+		assert(!lru_list.empty()); // @ all slots busy would need a wait
+		i = lru_list.front();
+		lru_list.pop_front();
+
+		Slot &slot = slot_list[i];
+		slot.busy = true; // loaders of the old block wait till it is on disk
+		lock.unlock();
+
+		demote(slot.key,slot.data);
+		clock.incr(HOST_EVICTED);
+
+		lock.lock();
+		slot_hash.erase(slot.key); // Only now, the write of the old block is already pending
+		cv.notify_all();
+	}
+
+	Slot &slot = slot_list[i];
+	slot.key = key;
+	slot.busy = true;
+	slot_hash[key] = i;
+	lock.unlock();
+
+	assert(size <= unit_mem_size);
+	std::memcpy(slot.data,src,size);
+
+	lock.lock();
+	slot.busy = false;
+	lru_list.push_back(i);
+	slot.self = std::prev(lru_list.end());
+	cv.notify_all();
+}
+
+bool HostCache::take(const Key &key, void *dst, size_t size) {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	int i = waitForSlot(lock,key);
+	if (i == -1) {
+		clock.incr(HOST_MISS);
+		return false;
+	}
+
+	Slot &slot = slot_list[i];
+	lru_list.erase(slot.self);
+	slot_hash.erase(key);
+	slot.busy = true;
+	lock.unlock();
+
+	std::memcpy(dst,slot.data,size);
+	clock.incr(HOST_HIT);
+
+	lock.lock();
+	slot.busy = false;
+	free_list.push_back(i);
+	return true;
+}
+
+void HostCache::drop(const Key &key) {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	int i = waitForSlot(lock,key);
+	if (i == -1)
+		return;
+
+	lru_list.erase(slot_list[i].self);
+	slot_hash.erase(key);
+	free_list.push_back(i);
+}
+
+} } // namespace map::detail
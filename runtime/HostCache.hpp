@@ -0,0 +1,79 @@
+/**
+ * @file    HostCache.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: second tier of the cache, in host memory. Dirty blocks evicted from the device are demoted here
+ * Note: tiers are exclusive, a block promoted back to the device leaves the host tier
+ * Note: when full, the least recently demoted block goes down to its temporal file, written behind by the Writers if any
+ * Note: slots have the size of the largest block, 'size' tells the bytes actually copied
+ * Note: a demoted block is queued / stored before its slot leaves 'slot_hash', loaders that miss wait for it after take()
+ *
+ * TODO: clean blocks (e.g. from input files) could also be kept here
+ */
+
+#ifndef MAP_RUNTIME_HOSTCACHE_HPP_
+#define MAP_RUNTIME_HOSTCACHE_HPP_
+
+#include "Block.hpp"
+#include "Config.hpp"
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+namespace map { namespace detail {
+
+class Clock; // Forward declaration
+
+class HostCache
+{
+	/*
+	 * Slot of host memory holding one block
+	 */
+	struct Slot {
+		Key key;
+		char *data;
+		bool busy; //!< Being copied in / out, or written to disk
+		std::list<int>::iterator self; //!< Position in 'lru_list'
+	};
+
+  public:
+	typedef std::function<void(const Key&,void*)> DemoteFunction; // Writes the block 'key' at 'data' to disk
+
+	HostCache(Clock &clock, Config &conf);
+	~HostCache();
+	HostCache(const HostCache&) = delete;
+	HostCache& operator=(const HostCache&) = delete;
+
+	void allocSlots(size_t unit_mem_size);
+	void freeSlots();
+	bool enabled() const;
+
+	void put(const Key &key, const void *src, size_t size, DemoteFunction demote);
+	bool take(const Key &key, void *dst, size_t size);
+	void drop(const Key &key);
+
+  private:
+	int waitForSlot(std::unique_lock<std::mutex> &lock, const Key &key);
+
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+
+	std::unique_ptr<char[]> memory; //!< Host memory, split in slots
+	std::vector<Slot> slot_list;
+	std::vector<int> free_list; //!< Slots without block
+	std::list<int> lru_list; //!< Slots with block, least recently demoted first
+	std::unordered_map<Key,int,key_hash> slot_hash; //!< Directory of the host tier
+	size_t unit_mem_size;
+
+	std::mutex mtx;
+	std::condition_variable cv; //!< Wakes the threads waiting for busy slots
+};
+
+} } // namespace map::detail
+
+#endif
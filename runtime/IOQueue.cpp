@@ -0,0 +1,98 @@
+/**
+ * @file    IOQueue.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "IOQueue.hpp"
+#include "Clock.hpp"
+
+
+namespace map { namespace detail {
+
+IOQueue::IOQueue(Clock &clock, Config &conf)
+	: clock(clock)
+	, conf(conf)
+	, num_pending(0)
+	, closed(true)
+{ }
+
+void IOQueue::open() {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	assert(num_pending == 0);
+	file_hash.clear(); // The files of the last evaluation might be deleted
+	ready_list.clear();
+	closed = false;
+}
+
+void IOQueue::close() {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	closed = true;
+	cv.notify_all();
+}
+
+bool IOQueue::enabled() const {
+	return conf.num_io_threads > 0;
+}
+
+std::future<Berr> IOQueue::submit(IFile *file, std::function<Berr()> op) {
+	Request req(op);
+	std::future<Berr> fut = req.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mtx); // thread-safe
+		if (enabled() && !closed) {
+			FileQueue &fq = file_hash[file]; // zero-initialized if new
+			fq.pending.push_back(std::move(req));
+			num_pending++;
+			markReady(file,fq);
+			return fut;
+		}
+	}
+	req(); // No I/O threads serving, runs here
+	return fut;
+}
+
+Berr IOQueue::run(IFile *file, std::function<Berr()> op) {
+	return submit(file,op).get();
+}
+
+void IOQueue::markReady(IFile *file, FileQueue &fq) {
+	// Note: the caller holds 'mtx'
+	if (fq.ready || fq.pending.empty() || fq.in_flight >= conf.file_queue_depth)
+		return;
+	ready_list.push_back(file);
+	fq.ready = true;
+	cv.notify_one();
+}
+
+bool IOQueue::serve() {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	// Waits for a file below its queue depth, or until closed and no requests are left
+	cv.wait(lock,[&]{ return !ready_list.empty() || (closed && num_pending == 0); });
+	if (ready_list.empty())
+		return false; // Exit point for the I/O threads
+
+	IFile *file = ready_list.front();
+	ready_list.pop_front();
+	FileQueue &fq = file_hash[file];
+	fq.ready = false;
+
+	Request req = std::move(fq.pending.front());
+	fq.pending.pop_front();
+	fq.in_flight++;
+	num_pending--;
+	markReady(file,fq); // Round-robin, back to the end
+
+	lock.unlock();
+	req(); // Reads / writes outside the lock, the waiting thread gets the result by its future
+	lock.lock();
+
+	fq.in_flight--;
+	markReady(file,fq);
+	if (closed && num_pending == 0)
+		cv.notify_all();
+	return true;
+}
+
+} } // namespace map::detail
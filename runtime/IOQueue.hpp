@@ -0,0 +1,73 @@
+/**
+ * @file    IOQueue.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: file reads / writes of the workers are served by a pool of I/O threads, the workers submit and wait
+ * Note: every file has its own queue, at most conf.file_queue_depth requests of a file are served at once
+ * Note: the files with requests are served round-robin, a busy file does not starve the others
+ * Note: without I/O threads, or once closed, the requests run in the calling thread as before
+ */
+
+#ifndef MAP_RUNTIME_IOQUEUE_HPP_
+#define MAP_RUNTIME_IOQUEUE_HPP_
+
+#include "Block.hpp"
+#include "Config.hpp"
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace map { namespace detail {
+
+class Clock; // Forward declaration
+class IFile; // Forward declaration
+
+class IOQueue
+{
+	typedef std::packaged_task<Berr()> Request;
+
+	/*
+	 * Submission queue of one file
+	 */
+	struct FileQueue {
+		std::deque<Request> pending; //!< Requests waiting for an I/O thread
+		int in_flight; //!< Requests being served
+		bool ready; //!< Listed in 'ready_list'
+	};
+
+  public:
+	IOQueue(Clock &clock, Config &conf);
+	IOQueue(const IOQueue&) = delete;
+	IOQueue& operator=(const IOQueue&) = delete;
+
+	void open();
+	void close();
+	bool enabled() const;
+
+	std::future<Berr> submit(IFile *file, std::function<Berr()> op);
+	Berr run(IFile *file, std::function<Berr()> op);
+	bool serve();
+
+  private:
+	void markReady(IFile *file, FileQueue &fq);
+
+  private:
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+
+	std::unordered_map<IFile*,FileQueue> file_hash; //!< Submission queue of every file
+	std::deque<IFile*> ready_list; //!< Files with pending requests below their queue depth
+	int num_pending; //!< Requests in all queues, not yet served
+	bool closed; //!< No more requests will be queued, the I/O threads exit when the queues empty
+
+	std::mutex mtx;
+	std::condition_variable cv;
+};
+
+} } // namespace map::detail
+
+#endif
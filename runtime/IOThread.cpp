@@ -0,0 +1,34 @@
+/**
+ * @file    IOThread.cpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "IOThread.hpp"
+#include "Cache.hpp"
+#include "Clock.hpp"
+
+
+namespace map { namespace detail {
+
+/************
+   IOThread
+ ************/
+
+IOThread::IOThread(Cache &cache, Clock &clock, Config &conf)
+	: cache(cache)
+	, clock(clock)
+	, conf(conf)
+{ }
+
+void IOThread::work(ThreadId thread_id) {
+	Tid = thread_id; // Local thread id initialization
+
+	while (true) // I/O loop
+	{
+		if (!cache.serveIO())
+			break; // Exit point
+	}
+}
+
+} } // namespace map::detail
@@ -0,0 +1,44 @@
+/**
+ * @file    IOThread.hpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * NOTE: I/O threads take the ranks after the writers (i.e. rank = num_ranks + num_prefetchers + num_writers + i)
+ * NOTE: they serve the file reads / writes that the workers submit to the IOQueue of the Cache
+ */
+
+#ifndef MAP_RUNTIME_IOTHREAD_HPP_
+#define MAP_RUNTIME_IOTHREAD_HPP_
+
+#include "ThreadId.hpp"
+#include "Config.hpp"
+
+
+namespace map { namespace detail {
+
+class Cache; // Forward declaration
+class Clock; // Forward declaration
+
+/*
+ * Serves the I/O requests of the workers, sized to the storage instead of to the cores
+ */
+class IOThread
+{
+  public:
+	IOThread(Cache &cache, Clock &clock, Config &conf);
+	~IOThread() = default;
+	IOThread(const IOThread&) = delete;
+	IOThread& operator=(const IOThread&) = delete;
+	IOThread(IOThread&&) = default;
+	IOThread& operator=(IOThread&&) = default;
+
+	void work(ThreadId thread_id);
+
+  private:
+	Cache &cache; // Aggregate
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+};
+
+} } // namespace map::detail
+
+#endif
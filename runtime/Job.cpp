@@ -83,7 +83,7 @@ Job::Job(Task *task, Coord coord)
 		h = 0;
 	}
 
-	order = Order(dif[0],dif[1],task->id(),h);
+	order = Order(dif[0],dif[1],task->priority(),h);
 }
 
 bool job_cmp::operator() (const Job &lhs, const Job &rhs) const {
@@ -100,4 +100,8 @@ std::size_t job_hash::operator()(const Job& j) const {
 	return h;
 }
 
+bool job_equal::operator()(const Job &lhs, const Job &rhs) const {
+	return lhs.task == rhs.task && all(lhs.coord == rhs.coord);
+}
+
 } } // namespace map::detail
@@ -53,6 +53,10 @@ struct job_hash {
 	std::size_t operator()(const Job &j) const;
 };
 
+struct job_equal {
+	bool operator()(const Job &lhs, const Job &rhs) const;
+};
+
 } } // namespace map::detail
 
 #endif
@@ -0,0 +1,123 @@
+/**
+ * @file    KernelCache.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: a missing, stale or unreadable entry is not an error, the version is compiled from source
+ * Note: entries are written to a temporal file and renamed, concurrent processes never read half an entry, see Persist.hpp
+ * Note: cle::Device::get() returns a static buffer, the identities are queried once under 'mtx'
+ */
+
+#include "KernelCache.hpp"
+#include "Version.hpp"
+#include "Persist.hpp"
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+
+
+namespace map { namespace detail {
+
+KernelCache::KernelCache(Config &conf)
+	: conf(conf)
+{ }
+
+std::string KernelCache::identity(cle::Device dev) const {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe, the compilers store concurrently
+	auto it = ident_hash.find(*dev);
+	if (it != ident_hash.end())
+		return it->second;
+
+	std::string &ident = ident_hash[*dev];
+	ident += (const char*) dev.P().get(CL_PLATFORM_VERSION);
+	ident += ";";
+	ident += (const char*) dev.get(CL_DEVICE_NAME);
+	ident += ";";
+	ident += (const char*) dev.get(CL_DEVICE_VERSION);
+	ident += ";";
+	ident += (const char*) dev.get(CL_DRIVER_VERSION);
+	for (auto &c : ident)
+		if (c == '\n')
+			c = ' '; // the identity is the first line of the entry
+	return ident;
+}
+
+std::string KernelCache::path(const Version *ver, const std::string &flags, const std::string &ident) const {
+	std::string dir = persistDir(conf.kernel_path);
+	if (dir.empty())
+		return ""; // Refused, nothing is loaded or stored
+	uint64_t hash = fnv1a(ver->signature());
+	hash = fnv1a(ver->code,hash);
+	hash = fnv1a(flags,hash);
+	hash = fnv1a(ident,hash);
+	char name[32];
+	snprintf(name,sizeof(name),"%016llx.bin",(unsigned long long)hash);
+	return dir + "/" + name;
+}
+
+bool KernelCache::load(const Version *ver, const std::string &flags, std::vector<unsigned char> &bin) const {
+	if (!conf.disk_cache)
+		return false;
+
+	std::string ident = identity(ver->device());
+	std::string file = path(ver,flags,ident);
+	if (file.empty())
+		return false;
+	std::ifstream in(file,std::ios::binary);
+	if (!in)
+		return false; // miss
+
+	std::string line;
+	size_t size = 0;
+	if (!std::getline(in,line) || line != ident)
+		return false; // stale, other driver or hash collision
+	if (!(in >> size) || in.get() != '\n' || size == 0)
+		return false; // truncated
+
+	bin.resize(size);
+	in.read((char*)bin.data(),size);
+	return (size_t)in.gcount() == size;
+}
+
+void KernelCache::store(const Version *ver, const std::string &flags, cl_program prg) const {
+	if (!conf.disk_cache)
+		return;
+	cl_int err;
+
+	// The program might span several devices of the context, picks the binary of 'ver'
+	cl_uint num_dev;
+	err = clGetProgramInfo(prg, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_dev, NULL);
+	cle::clCheckError(err);
+	std::vector<cl_device_id> dev_vec(num_dev);
+	err = clGetProgramInfo(prg, CL_PROGRAM_DEVICES, num_dev*sizeof(cl_device_id), dev_vec.data(), NULL);
+	cle::clCheckError(err);
+	std::vector<size_t> size_vec(num_dev);
+	err = clGetProgramInfo(prg, CL_PROGRAM_BINARY_SIZES, num_dev*sizeof(size_t), size_vec.data(), NULL);
+	cle::clCheckError(err);
+
+	int idx = -1;
+	for (int i=0; i<(int)num_dev; i++)
+		if (dev_vec[i] == *ver->device())
+			idx = i;
+	if (idx == -1 || size_vec[idx] == 0)
+		return; // @ the driver does not expose binaries
+
+	std::vector<std::vector<unsigned char>> bin_vec(num_dev);
+	std::vector<unsigned char*> ptr_vec(num_dev);
+	for (int i=0; i<(int)num_dev; i++) {
+		bin_vec[i].resize(size_vec[i]);
+		ptr_vec[i] = bin_vec[i].data();
+	}
+	err = clGetProgramInfo(prg, CL_PROGRAM_BINARIES, num_dev*sizeof(unsigned char*), ptr_vec.data(), NULL);
+	cle::clCheckError(err);
+
+	std::string ident = identity(ver->device());
+	std::string file = path(ver,flags,ident);
+	if (file.empty())
+		return;
+
+	std::string data = ident + "\n" + std::to_string(size_vec[idx]) + "\n";
+	data.append((const char*)bin_vec[idx].data(),size_vec[idx]);
+	persistFile(file,data); // @ not writable, the next run compiles again
+}
+
+} } // namespace map::detail
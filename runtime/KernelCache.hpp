@@ -0,0 +1,47 @@
+/**
+ * @file    KernelCache.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: compiled kernels of earlier runs, persisted as CL_PROGRAM_BINARIES under the per-user conf.kernel_path
+ * Note: entries are keyed by a stable hash of the version signature, code, build flags and device / driver identity
+ * Note: every entry starts with the identity line, a different driver never loads it and the source is compiled again
+ */
+
+#ifndef MAP_RUNTIME_KERNEL_CACHE_HPP_
+#define MAP_RUNTIME_KERNEL_CACHE_HPP_
+
+#include "Config.hpp"
+#include "../cle/cle.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+
+namespace map { namespace detail {
+
+struct Version; // forward declaration
+
+class KernelCache
+{
+  public:
+	KernelCache(Config &conf);
+	KernelCache(const KernelCache&) = delete;
+	KernelCache& operator=(const KernelCache&) = delete;
+
+	bool load(const Version *ver, const std::string &flags, std::vector<unsigned char> &bin) const;
+	void store(const Version *ver, const std::string &flags, cl_program prg) const;
+
+  private:
+	std::string identity(cle::Device dev) const;
+	std::string path(const Version *ver, const std::string &flags, const std::string &ident) const;
+
+	Config &conf; // Aggregate
+
+	mutable std::unordered_map<cl_device_id,std::string> ident_hash; //!< Identity of every device, queried once
+	mutable std::mutex mtx;
+};
+
+} } // namespace map::detail
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file    Persist.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: failures are not errors, the callers keep their data in memory and the next run starts afresh
+ */
+
+#include "Persist.hpp"
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+namespace map { namespace detail {
+
+namespace { // anonymous namespace
+
+/*
+ * Creates 'dir' if missing, then accepts it only if it is a real directory of the user, not writable by others
+ */
+bool privateDir(const std::string &dir) {
+	if (mkdir(dir.c_str(),0700) != 0 && errno != EEXIST)
+		return false;
+	struct stat st;
+	if (lstat(dir.c_str(),&st) != 0)
+		return false;
+	if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP|S_IWOTH)))
+		return false; // a symlink, or planted by another user
+	return true;
+}
+
+} // anonymous namespace
+
+uint64_t fnv1a(const std::string &str, uint64_t hash) {
+	for (unsigned char c : str) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string persistDir(const std::string &sub) {
+	std::string base;
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	if (xdg != nullptr && xdg[0] == '/') {
+		base = xdg;
+	} else if (home != nullptr && home[0] == '/') {
+		base = std::string(home) + "/.cache";
+		mkdir(base.c_str(),0700); // EEXIST is fine, the checks apply to 'map' below
+	} else {
+		return ""; // No per-user location
+	}
+
+	std::string dir = base + "/map";
+	if (!privateDir(dir))
+		return "";
+	if (!sub.empty()) {
+		dir += "/" + sub;
+		if (!privateDir(dir))
+			return "";
+	}
+	return dir;
+}
+
+bool persistFile(const std::string &path, const std::string &data) {
+	std::vector<char> temp(path.begin(),path.end());
+	const char suffix[] = ".XXXXXX";
+	temp.insert(temp.end(),suffix,suffix+sizeof(suffix)); // includes '\0'
+
+	int fd = mkstemp(temp.data()); // unique per thread and process, mode 0600
+	if (fd == -1)
+		return false;
+
+	const char *ptr = data.data();
+	size_t left = data.size();
+	while (left > 0) {
+		ssize_t ret = write(fd,ptr,left);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		ptr += ret;
+		left -= ret;
+	}
+
+	if (close(fd) != 0 || left > 0 || rename(temp.data(),path.c_str()) != 0) {
+		unlink(temp.data());
+		return false;
+	}
+	return true;
+}
+
+} } // namespace map::detail
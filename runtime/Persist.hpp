@@ -0,0 +1,38 @@
+/**
+ * @file    Persist.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Utilities of the files persisted across runs (kernel binaries, profile, tuning)
+ *
+ * Note: the files live in a per-user directory, $XDG_CACHE_HOME/map or ~/.cache/map, created with mode 0700
+ * Note: a directory not owned by the user, or writable by others, is refused and nothing is persisted
+ * Note: files are written to a unique temporal file and renamed, readers never see half a file
+ */
+
+#ifndef MAP_RUNTIME_PERSIST_HPP_
+#define MAP_RUNTIME_PERSIST_HPP_
+
+#include <string>
+#include <cstdint>
+
+
+namespace map { namespace detail {
+
+/*
+ * FNV-1a, unlike std::hash its value is the same across processes, builds and standard libraries
+ */
+uint64_t fnv1a(const std::string &str, uint64_t hash=14695981039346656037ULL);
+
+/*
+ * Returns the per-user directory (or its subdirectory 'sub'), creating it if needed. Empty when refused
+ */
+std::string persistDir(const std::string &sub="");
+
+/*
+ * Replaces 'path' with 'data' atomically. Returns false if it could not be written
+ */
+bool persistFile(const std::string &path, const std::string &data);
+
+} } // namespace map::detail
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file    Policy.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "Policy.hpp"
+#include "Block.hpp"
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+/***********
+   IPolicy
+ ***********/
+
+IPolicy* IPolicy::Factory(PolicyType type) {
+	/**/ if (type == LRU_POLICY)
+		return new LruPolicy();
+	else if (type == COORD_POLICY)
+		return new CoordPolicy();
+	else
+		assert(!"Unknown replacement policy");
+	return nullptr;
+}
+
+/*************
+   LruPolicy
+ *************/
+
+void LruPolicy::reset(int num_entry) {
+	prev.assign(num_entry,nullptr);
+	post.assign(num_entry,nullptr);
+	head = nullptr;
+	tail = nullptr;
+}
+
+void LruPolicy::insert(Entry *entry) {
+	int i = entry->id;
+	if (entry->block == nullptr) { // Free entries are replaced first
+		prev[i] = nullptr;
+		post[i] = head;
+		if (head != nullptr)
+			prev[head->id] = entry;
+		head = entry;
+		if (tail == nullptr)
+			tail = entry;
+	} else { // Most recently used
+		prev[i] = tail;
+		post[i] = nullptr;
+		if (tail != nullptr)
+			post[tail->id] = entry;
+		tail = entry;
+		if (head == nullptr)
+			head = entry;
+	}
+}
+
+void LruPolicy::remove(Entry *entry) {
+	int i = entry->id;
+	if (prev[i] != nullptr)
+		post[prev[i]->id] = post[i];
+	else
+		head = post[i];
+	if (post[i] != nullptr)
+		prev[post[i]->id] = prev[i];
+	else
+		tail = prev[i];
+	prev[i] = post[i] = nullptr;
+}
+
+Entry* LruPolicy::first() {
+	return head;
+}
+
+Entry* LruPolicy::next(Entry *entry) {
+	return post[entry->id];
+}
+
+std::string LruPolicy::name() const {
+	return "lru";
+}
+
+/***************
+   CoordPolicy
+ ***************/
+
+bool CoordPolicy::item_cmp::operator()(const Item &lhs, const Item &rhs) const {
+	if (lhs.dead != rhs.dead)
+		return lhs.dead; // Dead entries go first
+	if (rhs.order < lhs.order)
+		return true; // Then the highest order
+	if (lhs.order < rhs.order)
+		return false;
+	return lhs.entry->id < rhs.entry->id; // Ties broken by id
+}
+
+void CoordPolicy::reset(int num_entry) {
+	item_set.clear();
+	pos.assign(num_entry,item_set.end());
+}
+
+void CoordPolicy::insert(Entry *entry) {
+	Block *blk = entry->block;
+	Item item = {true,Order(),entry};
+
+	if (blk != nullptr && blk->dependencies != DEPEND_ZERO) {
+		// Ranked by the Morton order of its coordinate, not by the jobs actually queued
+		item.dead = false;
+		item.order = Order(blk->key.coord[0],blk->key.coord[1],0,0);
+	}
+	pos[entry->id] = item_set.insert(item).first;
+}
+
+void CoordPolicy::remove(Entry *entry) {
+	item_set.erase(pos[entry->id]);
+	pos[entry->id] = item_set.end();
+}
+
+Entry* CoordPolicy::first() {
+	return item_set.empty() ? nullptr : item_set.begin()->entry;
+}
+
+Entry* CoordPolicy::next(Entry *entry) {
+	auto it = std::next(pos[entry->id]);
+	return (it == item_set.end()) ? nullptr : it->entry;
+}
+
+std::string CoordPolicy::name() const {
+	return "coord";
+}
+
+} } // namespace map::detail
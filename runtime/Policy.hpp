@@ -0,0 +1,92 @@
+/**
+ * @file    Policy.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * NOTE: only unused entries are replacement candidates, the Cache inserts / removes them when 'used' drops to / leaves 0
+ * NOTE: the Cache serializes the calls to each policy with the lock of its part, the policies are not thread-safe by themselves
+ *
+ * TODO: a known-future (Belady) policy needs the next use of each block, i.e. the queued jobs of the Scheduler
+ */
+
+#ifndef MAP_RUNTIME_POLICY_HPP_
+#define MAP_RUNTIME_POLICY_HPP_
+
+#include "Entry.hpp"
+#include "Job.hpp"
+#include "Config.hpp"
+#include <vector>
+#include <set>
+#include <string>
+
+
+namespace map { namespace detail {
+
+/*
+ * Interface of the cache replacement policies
+ */
+class IPolicy
+{
+  public:
+	static IPolicy* Factory(PolicyType type);
+	virtual ~IPolicy() { };
+
+	virtual void reset(int num_entry) = 0; // Empties the policy, entries with 'id' in [0,num_entry)
+	virtual void insert(Entry *entry) = 0; // Unused entry becomes a replacement candidate
+	virtual void remove(Entry *entry) = 0; // Candidate entry starts being used
+	virtual Entry* first() = 0; // Best candidate to be replaced, nullptr when none
+	virtual Entry* next(Entry *entry) = 0; // Following candidate after 'entry', nullptr when none
+	virtual std::string name() const = 0;
+};
+
+/*
+ * Least Recently Used. Free entries go to the front, released entries to the back. All operations O(1)
+ */
+class LruPolicy : public IPolicy
+{
+  public:
+	void reset(int num_entry);
+	void insert(Entry *entry);
+	void remove(Entry *entry);
+	Entry* first();
+	Entry* next(Entry *entry);
+	std::string name() const;
+
+  private:
+	std::vector<Entry*> prev, post; //!< Intrusive doubly linked list, indexed by 'Entry::id'
+	Entry *head, *tail;
+};
+
+/*
+ * Dependency-aware coordinate order. Evicts dead blocks first, then the block with the highest Morton order
+ * Note: the order is static, it does not know which jobs are queued nor which task uses the block next
+ */
+class CoordPolicy : public IPolicy
+{
+	struct Item {
+		bool dead; //!< Free entry, or holding a block without more dependencies
+		Order order; //!< Morton order of the block coordinate
+		Entry *entry;
+	};
+
+	struct item_cmp {
+		bool operator()(const Item &lhs, const Item &rhs) const;
+	};
+
+	typedef std::set<Item,item_cmp> ItemSet;
+
+  public:
+	void reset(int num_entry);
+	void insert(Entry *entry);
+	void remove(Entry *entry);
+	Entry* first();
+	Entry* next(Entry *entry);
+	std::string name() const;
+
+  private:
+	ItemSet item_set; //!< Candidates, dead first, then from the highest to the lowest order
+	std::vector<ItemSet::iterator> pos; //!< Position of the candidates, indexed by 'Entry::id'
+};
+
+} } // namespace map::detail
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file    Prefetcher.cpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * TODO: the output blocks of upcoming jobs could also get their entries reserved here
+ */
+
+#include "Prefetcher.hpp"
+#include "Cache.hpp"
+#include "Scheduler.hpp"
+#include "Clock.hpp"
+#include "task/Task.hpp"
+
+
+namespace map { namespace detail {
+
+/**************
+   Prefetcher
+ **************/
+
+Prefetcher::Prefetcher(Cache &cache, Scheduler &sche, Clock &clock, Config &conf)
+	: cache(cache)
+	, sche(sche)
+	, clock(clock)
+	, conf(conf)
+{
+	job_vec.reserve(conf.max_prefetch_depth);
+	in_keys.reserve(conf.max_in_block);
+}
+
+void Prefetcher::work(ThreadId thread_id) {
+	Tid = thread_id; // Local thread id initialization
+	size_t version = 0; // Forces a first peek
+
+	while (true) // Prefetcher loop
+	{
+		if (!sche.peekJobs(job_vec,conf.prefetch_depth,version))
+			break; // Exit point
+
+		for (auto job : job_vec)
+			prefetch(job);
+	}
+}
+
+void Prefetcher::prefetch(Job job) {
+	TimedRegion region(clock,PREFETCH); // Timed function
+
+	job.task->blocksToLoad(job.coord,in_keys);
+
+	for (auto &i : in_keys) {
+		if (std::get<1>(i) == HOLD_N) // Only blocks with N values live in the cache entries
+			cache.prefetch(std::get<0>(i));
+	}
+}
+
+} } // namespace map::detail
@@ -0,0 +1,53 @@
+/**
+ * @file    Prefetcher.hpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * NOTE: prefetchers are I/O threads, they take the ranks after the workers (i.e. rank = num_ranks + i)
+ * NOTE: prefetched blocks only take free entries, they never evict blocks from the cache
+ */
+
+#ifndef MAP_RUNTIME_PREFETCHER_HPP_
+#define MAP_RUNTIME_PREFETCHER_HPP_
+
+#include "Job.hpp"
+#include "Block.hpp"
+#include "ThreadId.hpp"
+#include "Config.hpp"
+#include <vector>
+
+
+namespace map { namespace detail {
+
+class Cache; // Forward declaration
+class Scheduler; // Forward declaration
+class Clock; // Forward declaration
+
+/*
+ * Peeks at the upcoming jobs in the Scheduler and loads their input blocks ahead of time
+ */
+class Prefetcher
+{
+  public:
+	Prefetcher(Cache &cache, Scheduler &sche, Clock &clock, Config &conf);
+	~Prefetcher() = default;
+	Prefetcher(const Prefetcher&) = delete;
+	Prefetcher& operator=(const Prefetcher&) = delete;
+	Prefetcher(Prefetcher&&) = default;
+	Prefetcher& operator=(Prefetcher&&) = default;
+
+	void work(ThreadId thread_id);
+	void prefetch(Job job);
+
+  private:
+	Cache &cache; // Aggregate
+	Scheduler &sche; // Aggregate
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+
+	std::vector<Job> job_vec;
+	InKeyList in_keys;
+};
+
+} } // namespace map::detail
+
+#endif
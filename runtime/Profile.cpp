@@ -0,0 +1,64 @@
+/**
+ * @file    Profile.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: a missing or unreadable profile file is not an error, the ranking falls back to estimates
+ */
+
+#include "Profile.hpp"
+#include "Persist.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+
+namespace map { namespace detail {
+
+Profile::Profile(Config &conf)
+	: conf(conf)
+	, loaded(false)
+{ }
+
+void Profile::load() {
+	if (loaded)
+		return; // Only once, later runs are merged in memory
+	loaded = true;
+
+	std::string dir = persistDir();
+	if (dir.empty())
+		return; // Refused, the profile starts empty and is not saved
+	std::ifstream in(dir + "/" + conf.profile_path);
+	uint64_t hash;
+	Time time;
+	while (in >> hash >> time.sec >> time.jobs)
+		time_hash[hash] = time;
+}
+
+void Profile::save() const {
+	std::string dir = persistDir();
+	if (dir.empty())
+		return; // @ not writable, the profile stays in memory
+	std::ostringstream out;
+	for (auto &it : time_hash)
+		out << it.first << " " << it.second.sec << " " << it.second.jobs << "\n";
+	persistFile(dir + "/" + conf.profile_path, out.str()); // concurrent runs replace the whole file, never mix it
+}
+
+bool Profile::find(const std::string &ver_sign, double &sec) const {
+	auto it = time_hash.find(fnv1a(ver_sign));
+	if (it == time_hash.end())
+		return false;
+	sec = it->second.sec;
+	return true;
+}
+
+void Profile::update(const std::string &ver_sign, double total_sec, long jobs) {
+	if (jobs == 0)
+		return;
+	Time &time = time_hash[fnv1a(ver_sign)]; // zero-initialized if new
+	long old_jobs = std::min(time.jobs,max_jobs);
+	time.sec = (time.sec*old_jobs + total_sec) / (old_jobs + jobs);
+	time.jobs = old_jobs + jobs;
+}
+
+} } // namespace map::detail
@@ -0,0 +1,52 @@
+/**
+ * @file    Profile.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: kernel times per job measured in earlier runs, persisted to conf.profile_path in the per-user directory
+ * Note: versions are identified by the FNV-1a hash of their signature, one line per version "hash seconds jobs"
+ * Note: the jobs count saturates at 'max_jobs', the mean then follows the recent runs
+ */
+
+#ifndef MAP_RUNTIME_PROFILE_HPP_
+#define MAP_RUNTIME_PROFILE_HPP_
+
+#include "Config.hpp"
+#include <unordered_map>
+#include <string>
+#include <cstdint>
+
+
+namespace map { namespace detail {
+
+class Profile
+{
+	/*
+	 * Mean kernel time of one version
+	 */
+	struct Time {
+		double sec; //!< Seconds per job
+		long jobs; //!< Jobs measured so far
+	};
+
+  public:
+	Profile(Config &conf);
+	Profile(const Profile&) = delete;
+	Profile& operator=(const Profile&) = delete;
+
+	void load();
+	void save() const;
+	bool find(const std::string &ver_sign, double &sec) const;
+	void update(const std::string &ver_sign, double total_sec, long jobs);
+
+  private:
+	Config &conf; // Aggregate
+
+	std::unordered_map<uint64_t,Time> time_hash; //!< Hash of the version signature --> time per job
+	bool loaded;
+
+	static const long max_jobs = 1000;
+};
+
+} } // namespace map::detail
+
+#endif
@@ -2,9 +2,8 @@
  * @file    Program.cpp 
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
- * Note: clBuildProgram is sequential, using threads does not help
- *
- * TODO: perhaps change std::thread to std::async and std::future
+ * Note: clBuildProgram is sequential in some drivers, yet the compilers overlap with the workers running built tasks
+ * Note: binaries from the KernelCache are also linked by the compilers, generate() only creates their programs
  */
 
 #include "Program.hpp"
@@ -13,7 +12,9 @@
 #include "skeleton/Skeleton.hpp"
 #include "Runtime.hpp"
 #include <memory>
-#include <thread>
+#include <climits>
+#include <algorithm>
+#include <functional>
 
 
 namespace map { namespace detail {
@@ -25,12 +26,16 @@ namespace map { namespace detail {
 Program::Program(Clock &clock, Config &conf)
 	: clock(clock)
 	, conf(conf)
+	, profile(conf)
+	, tuning(conf)
+	, kernel_cache(conf)
 { }
 
 void Program::clear() {
 	task_list.clear();
 	// Note: ver_cache is not cleared
 	ver_to_comp.clear();
+	waiting_on.clear();
 }
 
 void Program::addTask(Task *task) {
@@ -52,6 +57,8 @@ void Program::compose(OwnerGroupList& group_list) {
 void Program::generate() {
 	TimedRegion region(clock,CODGEN);
 
+	tuning.load();
+
 	for (auto task : task_list) // For every task...
 	{
 		if (task->numdim() == D0)
@@ -65,23 +72,39 @@ void Program::generate() {
 			if (it != ver_cache.end() && conf.compil_cache) // Similar version found in cache
 			{
 				ver->copyParams(it->second);
+
+				// The copied version might still be compiling in this evaluation
+				auto wait = waiting_on.find(it->second);
+				if (wait != waiting_on.end()) {
+					wait->second.push_back(task);
+					task->pending_vers++;
+				}
 			}
 			else // Version code not found, has to generate it
 			{
 				// Ask Skel::Factory() for the appropiate skeleton
 				auto skel = std::unique_ptr<Skeleton>( Skeleton::Factory(ver) );
 
+				// Group size tuned by earlier runs
+				bool tuned = skel->tunable() && tuning.find(ver,ver->tune_size);
+
 				// Generates the code and configures the version
 				skel->generate();
 
-				// Creates the cl_task (aka cl_program)
-				ver->createProgram();
+				// Creates the cl_task (aka cl_program), from the kernel cache when possible
+				ver->createProgram(kernel_cache);
 
 				// Adds version to cache
 				ver_cache[ver->signature()] = ver;
 
 				// Adds 'ver' to the list of versions to be compiled
 				ver_to_comp.push_back(ver);
+				waiting_on[ver].push_back(task);
+				task->pending_vers++;
+
+				// Otherwise other group sizes are benchmarked along
+				if (conf.autotuning && skel->tunable() && !tuned && task->numdim() == D2)
+					addCandidates(ver);
 			}
 		}
 	}
@@ -89,19 +112,167 @@ void Program::generate() {
 	print();
 }
 
-void Program::compile() {
+void Program::addCandidates(Version *ver) {
+	for (auto &gs : tuning.candidates(ver)) {
+		Version *cand = new Version(ver->task,ver->device(),ver->detail);
+		cand->tune_size = gs;
+
+		auto skel = std::unique_ptr<Skeleton>( Skeleton::Factory(cand) );
+		skel->generate();
+		cand->createProgram(kernel_cache);
+
+		ver->tune_list.push_back( std::unique_ptr<Version>(cand) ); // Owned by 'ver', not by the Runtime
+		ver_to_comp.push_back(cand);
+		waiting_on[cand]; // No task waits for the candidates
+	}
+}
+
+void Program::pickCandidate(Version *ver) {
+	// The fastest per job among the version and its candidates measured
+	Version *best = ver;
+	double best_sec = (ver->krn_jobs > 0) ? (double)ver->krn_nsec / ver->krn_jobs : -1;
+	for (auto &cand : ver->tune_list) {
+		if (cand->krn_jobs == 0 || !cand->fits)
+			continue;
+		double sec = (double)cand->krn_nsec / cand->krn_jobs;
+		if (best_sec < 0 || sec < best_sec) {
+			best = cand.get();
+			best_sec = sec;
+		}
+	}
+	if (best_sec >= 0) { // Otherwise nothing was measured, the next run tunes again
+		tuning.update(ver,best->groupsize());
+		if (best != ver)
+			ver->copyParams(best); // Later evaluations copy the winner from the 'ver_cache'
+		ver->tune_size = ver->groupsize();
+	}
+	ver->tune_list.clear(); // The compilers are done, see wait()
+}
+
+void Program::compile(std::function<void(Task*)> ready) {
+	TimedRegion region(clock,COMPIL);
+
+	// Versions of the most urgent tasks go first
+	auto urgency = [&](Version *ver) {
+		int prio = INT_MAX;
+		for (auto task : waiting_on[ver])
+			prio = std::min(prio,task->priority());
+		return prio;
+	};
+	std::stable_sort(ver_to_comp.begin(),ver_to_comp.end(),[&](Version *lhs, Version *rhs){ return urgency(lhs) < urgency(rhs); });
+
+	// Room for all kernels, the workers read the kernels of ready tasks while the compilers add more
+	int num_krn = 0;
+	for (auto ver : ver_to_comp)
+		num_krn += conf.num_ranks * (ver->batched ? 2 : 1);
+	if (num_krn > 0)
+		ver_to_comp.front()->device().environment().reserveKernels(num_krn);
+
+	// Launchs the compiler threads, they return before the workers are done
+	next_comp = 0;
+	int num_thr = std::min<int>(conf.num_compilers,ver_to_comp.size());
+	for (int i=0; i<num_thr; i++)
+		comp_list.push_back( std::async(std::launch::async,&Program::compileLoop,this,ready) );
+}
+
+void Program::compileLoop(std::function<void(Task*)> ready) {
+	while (true) {
+		int i = next_comp++;
+		if (i >= (int)ver_to_comp.size())
+			return;
+		Version *ver = ver_to_comp[i];
+
+		ver->compileProgram(kernel_cache);
+
+		// The last version built makes the task ready
+		for (auto task : waiting_on.find(ver)->second)
+			if (--task->pending_vers == 0)
+				ready(task);
+	}
+}
+
+void Program::wait() {
 	TimedRegion region(clock,COMPIL);
-	std::vector<std::unique_ptr<std::thread>> vth;
 
-	// Launchs asynchronous threads to compile in parallel
-	for (auto ver : ver_to_comp) {
-		auto *thr = new std::thread( &Version::compileProgram, ver);
-		vth.push_back( std::unique_ptr<std::thread>(thr) );
+	// Waits for the compiler threads to finish, rethrows their errors
+	for (auto &fut : comp_list)
+		fut.get();
+	comp_list.clear();
+}
+
+void Program::rank() {
+	if (!conf.task_ranking)
+		return; // Tasks keep their id as priority
+
+	profile.load();
+
+	// Upward rank, the cost of the task plus the longest path through its next tasks
+	std::unordered_map<Task*,double> rank_hash;
+	for (auto task : task_list)
+		upwardRank(task,rank_hash);
+
+	// Dense priorities, the longest remaining path goes first, then the topological order
+	std::vector<Task*> sorted = task_list;
+	auto cmp = [&](Task *lhs, Task *rhs) {
+		double l = rank_hash[lhs], r = rank_hash[rhs];
+		return (l != r) ? l > r : lhs->id() < rhs->id();
+	};
+	std::sort(sorted.begin(),sorted.end(),cmp);
+	for (int i=0; i<sorted.size(); i++)
+		sorted[i]->prio = i;
+}
+
+double Program::upwardRank(Task *task, std::unordered_map<Task*,double> &rank_hash) {
+	auto it = rank_hash.find(task);
+	if (it != rank_hash.end())
+		return it->second;
+
+	rank_hash[task] = 0; // Guards against cycles (e.g. loops)
+	double next_max = 0;
+	for (auto next : task->nextList())
+		next_max = std::max(next_max,upwardRank(next,rank_hash));
+
+	return rank_hash[task] = cost(task) + next_max;
+}
+
+double Program::cost(Task *task) {
+	// Slowest version of the task found in the profile, otherwise an estimate by pattern
+	double job_sec = 0;
+	for (auto ver : task->versionList()) {
+		double sec;
+		if (profile.find(ver->signature(),sec))
+			job_sec = std::max(job_sec,sec);
+	}
+	if (job_sec == 0) {
+		Pattern pat = task->pattern();
+		int weight = pat.is(SPREAD) ? 8 : pat.is(RADIAL) ? 4 : pat.is(FOCAL) ? 2 : 1; // @
+		job_sec = conf.def_job_cost * weight;
 	}
+	return job_sec * prod(task->numblock());
+}
 
-	// Waits for threads to finish
-	for (auto &thread : vth)
-		thread->join();
+void Program::measure() {
+	// Picks the group sizes benchmarked in this evaluation, then persists them
+	if (conf.autotuning) {
+		for (auto task : task_list)
+			for (auto ver : task->versionList())
+				if (!ver->tune_list.empty())
+					pickCandidate(ver);
+		tuning.save();
+	}
+
+	if (!conf.task_ranking)
+		return;
+
+	// Merges the kernel times of this evaluation into the profile, then persists it
+	for (auto task : task_list) {
+		for (auto ver : task->versionList()) {
+			profile.update(ver->signature(),ver->krn_nsec/1e9,ver->krn_jobs);
+			ver->krn_nsec = 0;
+			ver->krn_jobs = 0;
+		}
+	}
+	profile.save();
 }
 
 const std::vector<Task*>& Program::taskList() const {
@@ -2,14 +2,24 @@
  * @file    Program.hpp 
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: tasks are ranked by the length of their critical path, measured with the kernel times of the Profile
+ * Note: versions are compiled asynchronously by 'num_compilers' threads, in priority order, while the workers run
+ * Note: a task is ready when all its versions are built, including those copied from a version still compiling
+ * Note: tuning candidates are compiled last and no task waits for them, see Tuning.hpp
  */
 
 #ifndef MAP_RUNTIME_PROGRAM_HPP_
 #define MAP_RUNTIME_PROGRAM_HPP_
 
 #include "Config.hpp"
+#include "Profile.hpp"
+#include "Tuning.hpp"
+#include "KernelCache.hpp"
 #include "task/Task.hpp"
 #include <vector>
+#include <future>
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
 
@@ -33,7 +43,10 @@ class Program
 
 	void compose(OwnerGroupList& group_list);
 	void generate();
-	void compile();
+	void compile(std::function<void(Task*)> ready);
+	void wait();
+	void rank();
+	void measure();
 
 	void addTask(Task *task);
 	const std::vector<Task*>& taskList() const;
@@ -41,12 +54,24 @@ class Program
 	void print();
 	
   private:
+	void compileLoop(std::function<void(Task*)> ready);
+	void addCandidates(Version *ver);
+	void pickCandidate(Version *ver);
+	double cost(Task *task);
+	double upwardRank(Task *task, std::unordered_map<Task*,double> &rank_hash);
+
 	Clock &clock; // Aggregate
 	Config &conf; // Aggregate
 
 	std::vector<Task*> task_list; //!< List of tasks composing the user program
 	std::unordered_map<std::string,Version*> ver_cache; //!< Cache of already generated versions
 	VersionList ver_to_comp; //!< List of Versions to be compiled
+	std::unordered_map<Version*,TaskList> waiting_on; //!< Tasks waiting for each version of 'ver_to_comp'
+	std::vector<std::future<void>> comp_list; //!< Compiler threads of this evaluation
+	std::atomic<int> next_comp; //!< Next version of 'ver_to_comp' to be compiled
+	Profile profile; //!< Kernel times of this and earlier runs
+	Tuning tuning; //!< Group sizes of this and earlier runs
+	KernelCache kernel_cache; //!< Kernel binaries of this and earlier runs
 };
 
 } } // namespace map::detail
@@ -0,0 +1,202 @@
+/**
+ * @file    ResultCache.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: Read nodes also sign the modification time of their file, rewritten files are not reused
+ * Note: radiating / spreading / special / barrier nodes, and all their successors, are never reused
+ * Note: copies are done outside the shard locks, only the directory is updated under them
+ */
+
+#include "ResultCache.hpp"
+#include "Clock.hpp"
+#include "dag/Read.hpp"
+#include "dag/Temporal.hpp"
+#include <functional>
+#include <vector>
+#include <sys/stat.h>
+#include <cstring>
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+bool ResultCache::ResultKey::operator==(const ResultKey& k) const {
+	return (sign==k.sign && all(coord==k.coord));
+}
+
+std::size_t ResultCache::result_hash::operator()(const ResultKey &k) const {
+	std::size_t h = k.sign;
+	for (int i=0; i<k.coord.size(); i++)
+		h ^= (size_t)k.coord[i] << (i*16);
+	return h;
+}
+
+ResultCache::ResultCache(Clock &clock, Config &conf)
+	: clock(clock)
+	, conf(conf)
+{
+	shard_list = std::unique_ptr<Shard[]>(new Shard[conf.cache_num_shard]);
+	shard_mask = conf.cache_num_shard - 1;
+	for (int i=0; i<conf.cache_num_shard; i++)
+		shard_list[i].used_size = 0;
+}
+
+void ResultCache::sign(const NodeList &list) {
+	// Note: called before the workers start, they only read 'sign_hash'
+	for (auto node : list)
+		signNode(node);
+}
+
+void ResultCache::unsign() {
+	sign_hash.clear(); // The nodes die with the evaluation, the blocks stay
+}
+
+size_t ResultCache::signOf(Node *node) const {
+	auto it = sign_hash.find(node);
+	return (it != sign_hash.end()) ? it->second : 0;
+}
+
+bool ResultCache::enabled() const {
+	return conf.result_cache_size > 0;
+}
+
+size_t ResultCache::signNode(Node *node) {
+	auto it = sign_hash.find(node);
+	if (it != sign_hash.end())
+		return it->second;
+
+	size_t sign = 0;
+	Pattern pat = node->pattern();
+	bool reusable = !pat.is(RADIAL) && !pat.is(SPREAD) && !pat.is(SPECIAL) && !pat.is(BARRIER);
+	reusable = reusable && dynamic_cast<Temporal*>(node) == nullptr;
+
+	if (reusable) {
+		auto mix = [&](size_t h) { sign ^= h + 0x9E3779B97F4A7C15ull + (sign << 6) + (sign >> 2); };
+
+		sign = std::hash<std::string>()(node->signature());
+		for (int i=0; i<node->datasize().size(); i++)
+			mix(node->datasize()[i]);
+		for (int i=0; i<node->blocksize().size(); i++)
+			mix(node->blocksize()[i]);
+
+		auto *read = dynamic_cast<Read*>(node);
+		if (read != nullptr) {
+			struct stat st;
+			if (stat(read->file()->getFilePath().c_str(),&st) == 0)
+				mix(st.st_mtim.tv_sec * 1000000007ull + st.st_mtim.tv_nsec);
+		}
+
+		for (auto prev : node->prevList()) { // Order matters, a-b != b-a
+			size_t prev_sign = signNode(prev);
+			if (prev_sign == 0) { // Non-reusable predecessors make the node non-reusable too
+				sign = 0;
+				break;
+			}
+			mix(prev_sign);
+		}
+	}
+
+	sign_hash[node] = sign;
+	return sign;
+}
+
+ResultCache::ResultKey ResultCache::resultKey(const Key &key) const {
+	return ResultKey{signOf(key.node),key.coord};
+}
+
+ResultCache::Shard& ResultCache::shardOf(const ResultKey &rkey) {
+	std::size_t h = result_hash()(rkey);
+	h ^= h >> 32;
+	h *= 0x9E3779B97F4A7C15ull; // Fibonacci hashing, as Cache::shardOf
+	return shard_list[(h >> 40) & shard_mask];
+}
+
+void ResultCache::put(const Key &key, const void *src, size_t size) {
+	ResultKey rkey = resultKey(key);
+	assert(rkey.sign != 0);
+	Shard &shard = shardOf(rkey);
+	const size_t shard_size = conf.result_cache_size / (shard_mask + 1);
+
+	if (size > shard_size)
+		return; // Would never fit
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+		auto it = shard.result_hash_map.find(rkey);
+		if (it != shard.result_hash_map.end()) { // Same node & coord means same data, only refreshes
+			shard.lru_list.splice(shard.lru_list.end(),shard.lru_list,it->second.self);
+			return;
+		}
+	}
+
+	// Allocates and copies without the lock
+	std::shared_ptr<char> data(new char[size],std::default_delete<char[]>());
+	std::memcpy(data.get(),src,size);
+	std::vector<std::shared_ptr<char>> dropped; // freed after releasing the lock
+
+	std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+	auto it = shard.result_hash_map.find(rkey);
+	if (it != shard.result_hash_map.end()) { // Kept by another thread meanwhile
+		shard.lru_list.splice(shard.lru_list.end(),shard.lru_list,it->second.self);
+		return;
+	}
+
+	while (shard.used_size + size > shard_size) { // Least recently used go first
+		auto old = shard.result_hash_map.find(shard.lru_list.front());
+		shard.used_size -= old->second.size;
+		dropped.push_back(std::move(old->second.data));
+		shard.result_hash_map.erase(old);
+		shard.lru_list.pop_front();
+	}
+
+	Result &res = shard.result_hash_map[rkey];
+	res.data = std::move(data);
+	res.size = size;
+	shard.lru_list.push_back(rkey);
+	res.self = std::prev(shard.lru_list.end());
+	shard.used_size += size;
+}
+
+bool ResultCache::get(const Key &key, void *dst, size_t size) {
+	ResultKey rkey = resultKey(key);
+	Shard &shard = shardOf(rkey);
+	std::shared_ptr<char> data;
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+		auto it = shard.result_hash_map.find(rkey);
+		if (it != shard.result_hash_map.end() && it->second.size == size) {
+			data = it->second.data; // keeps the data alive even if dropped meanwhile
+			shard.lru_list.splice(shard.lru_list.end(),shard.lru_list,it->second.self);
+		}
+	}
+
+	if (data == nullptr) {
+		clock.incr(RESULT_MISS);
+		return false;
+	}
+
+	std::memcpy(dst,data.get(),size);
+	clock.incr(RESULT_HIT);
+	return true;
+}
+
+bool ResultCache::contains(const Key &key) {
+	ResultKey rkey = resultKey(key);
+	Shard &shard = shardOf(rkey);
+	std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, only this shard
+	return shard.result_hash_map.find(rkey) != shard.result_hash_map.end();
+}
+
+void ResultCache::clear() {
+	for (int i=0; i<=shard_mask; i++) {
+		Shard &shard = shard_list[i];
+		std::lock_guard<std::mutex> lock(shard.mtx); // thread-safe, one shard at a time
+		shard.result_hash_map.clear();
+		shard.lru_list.clear();
+		shard.used_size = 0;
+	}
+	sign_hash.clear();
+}
+
+} } // namespace map::detail
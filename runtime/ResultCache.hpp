@@ -0,0 +1,94 @@
+/**
+ * @file    ResultCache.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: persistent cache of blocks in host memory, it outlives the evaluations (i.e. Runtime::workflow)
+ * Note: blocks are keyed by the structural signature of their node (see sign()) and their coordinate
+ * Note: the nodes of every evaluation are clones, the signatures identify them across evaluations
+ * Note: bounded by conf.result_cache_size, the least recently used blocks are dropped first
+ * Note: striped like the Cache directory, each shard holds its share of conf.result_cache_size
+ * Note: off by default (result_cache_size = 0), see setResultCacheSize in map.py
+ * Note: jobs reusing all their outputs skip loading their inputs, which are only notified, see Worker::load
+ */
+
+#ifndef MAP_RUNTIME_RESULTCACHE_HPP_
+#define MAP_RUNTIME_RESULTCACHE_HPP_
+
+#include "Block.hpp"
+#include "Config.hpp"
+#include "dag/Node.hpp"
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+
+namespace map { namespace detail {
+
+class Clock; // Forward declaration
+
+class ResultCache
+{
+	/*
+	 * Key of a block that is independent of the evaluation
+	 */
+	struct ResultKey {
+		size_t sign; //!< Structural signature of the node
+		Array4<int> coord; //!< Coordinate of the block
+
+		bool operator==(const ResultKey& k) const;
+	};
+
+	struct result_hash {
+		std::size_t operator()(const ResultKey& k) const;
+	};
+
+	struct Result {
+		std::shared_ptr<char> data; //!< Shared, readers copy from it after releasing the shard
+		size_t size;
+		std::list<ResultKey>::iterator self; //!< Position in 'lru_list'
+	};
+
+	typedef std::unordered_map<ResultKey,Result,result_hash> ResultHash;
+
+	/*
+	 * Stripe of the result directory
+	 */
+	struct Shard {
+		std::mutex mtx; //!< Protects the members below, copies are done outside
+		ResultHash result_hash_map; //!< Directory of the cached blocks (only this stripe)
+		std::list<ResultKey> lru_list; //!< Cached blocks, least recently used first
+		size_t used_size; //!< Bytes held by the cached blocks
+	};
+
+  public:
+	ResultCache(Clock &clock, Config &conf);
+	ResultCache(const ResultCache&) = delete;
+	ResultCache& operator=(const ResultCache&) = delete;
+
+	void sign(const NodeList &list);
+	void unsign();
+	size_t signOf(Node *node) const;
+	bool enabled() const;
+
+	void put(const Key &key, const void *src, size_t size);
+	bool get(const Key &key, void *dst, size_t size);
+	bool contains(const Key &key);
+	void clear();
+
+  private:
+	size_t signNode(Node *node);
+	ResultKey resultKey(const Key &key) const;
+	Shard& shardOf(const ResultKey &rkey);
+
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+
+	std::unordered_map<Node*,size_t> sign_hash; //!< Signatures of the nodes being evaluated, 0 when not reusable
+	std::unique_ptr<Shard[]> shard_list; //!< Striped directory, by 'result_hash'
+	int shard_mask; //!< Number of shards - 1, power of 2
+};
+
+} } // namespace map::detail
+
+#endif
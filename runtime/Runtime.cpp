@@ -51,9 +51,14 @@ Runtime::Runtime()
 	, clock(conf)
 	, program(clock,conf)
 	, cache(program,clock,conf)
-	, scheduler(program,clock,conf)
+	, scheduler(program,cache,clock,conf)
 	, workers()
+	, prefetchers()
+	, writers()
+	, io_threads()
 	, threads()
+	, writer_threads()
+	, io_handles()
 	, node_list()
 	, group_list()
 	, task_list()
@@ -68,6 +73,15 @@ Runtime::Runtime()
 	for (int i=0; i<conf.max_num_workers; i++) {
 		workers.emplace_back(cache,scheduler,clock,conf);
 	}
+	for (int i=0; i<conf.max_num_machines*conf.max_num_devices*conf.max_num_prefetchers; i++) {
+		prefetchers.emplace_back(cache,scheduler,clock,conf);
+	}
+	for (int i=0; i<conf.max_num_machines*conf.max_num_devices*conf.max_num_writers; i++) {
+		writers.emplace_back(cache,clock,conf);
+	}
+	for (int i=0; i<conf.max_num_machines*conf.max_num_devices*conf.max_num_io_threads; i++) {
+		io_threads.emplace_back(cache,clock,conf);
+	}
 
 	// Initialize loop supporting structures
 	loop_struct.resize(conf.nested_loop_limit);
@@ -138,9 +152,12 @@ void Runtime::setupDevices(std::string plat_name, DeviceType dev, std::string de
 		cle::Context ctx = clenv.C(i);
 		for (int j=0; j<ctx.nD(); j++) {
 			cle::Device dev = ctx.D(j);
-			for (int k=0; k<conf.num_ranks; k++) {
+			int num_que = conf.num_ranks + conf.num_prefetchers + conf.num_writers; // I/O threads come after the workers
+			if (conf.pipeline_depth > 1)
+				num_que += conf.num_ranks; // Transfer queues of the workers come last, see Block::queue
+			for (int k=0; k<num_que; k++) {
 				cl_int err;
-				cl_command_queue que = clCreateCommandQueue(*ctx, *dev, 0, &err);
+				cl_command_queue que = clCreateCommandQueue(*ctx, *dev, CL_QUEUE_PROFILING_ENABLE, &err);
 				cle::clCheckError(err);
 				ctx.addQueue(*dev, que);
 			}
@@ -327,9 +344,63 @@ void Runtime::work() {
 		}
 	}
 
-	// Workers gathering
+	// Threads spawn, each with a prefetcher. Ranks after the workers
+	int j = 0;
+	for (int n=0; n<conf.num_machines; n++) {
+		for (int d=0; d<conf.num_devices; d++) {
+			for (int p=0; p<conf.num_prefetchers; p++) {
+				auto thr = new std::thread(&Prefetcher::work, &prefetchers[j], ThreadId(n,d,conf.num_ranks+p));
+				threads.push_back( std::unique_ptr<std::thread>(thr) );
+				j++;
+			}
+		}
+	}
+
+	// Threads spawn, each with a writer. Ranks after the prefetchers
+	int k = 0;
+	for (int n=0; n<conf.num_machines; n++) {
+		for (int d=0; d<conf.num_devices; d++) {
+			for (int w=0; w<conf.num_writers; w++) {
+				auto thr = new std::thread(&Writer::work, &writers[k], ThreadId(n,d,conf.num_ranks+conf.num_prefetchers+w));
+				writer_threads.push_back( std::unique_ptr<std::thread>(thr) );
+				k++;
+			}
+		}
+	}
+
+	// Threads spawn, each with an I/O thread. Ranks after the writers
+	int l = 0;
+	for (int n=0; n<conf.num_machines; n++) {
+		for (int d=0; d<conf.num_devices; d++) {
+			for (int o=0; o<conf.num_io_threads; o++) {
+				int rnk = conf.num_ranks + conf.num_prefetchers + conf.num_writers + o;
+				auto thr = new std::thread(&IOThread::work, &io_threads[l], ThreadId(n,d,rnk));
+				io_handles.push_back( std::unique_ptr<std::thread>(thr) );
+				l++;
+			}
+		}
+	}
+
+	// Workers and prefetchers gathering
 	for (auto &thr : threads)
 		thr->join();
+
+	// I/O threads gathering, nobody submits anymore
+	cache.closeIO();
+	for (auto &thr : io_handles)
+		thr->join();
+	io_handles.clear();
+}
+
+void Runtime::drain() {
+	TimedRegion region(clock,EXEC);
+
+	cache.drainWrites();
+
+	// Writers gathering, they exit once the queue is empty
+	for (auto &thr : writer_threads)
+		thr->join();
+	writer_threads.clear();
 }
 
 Node* Runtime::addNode(Node *node) {
@@ -490,18 +561,30 @@ void Runtime::workflow(NodeList list) {
 	// Parallel code generation
 	program.generate();
 
-	// Code compilation
-	program.compile();
+	// Task ranking by critical path
+	program.rank();
 
 	// Allocation of cache entries
 	cache.allocEntries();
 	
-	// Adding initial jobs
+	// Adding initial jobs, those of tasks not yet compiled are held
 	scheduler.addInitialJobs();
 
+	// Asynchronous code compilation, every task built releases its held jobs
+	program.compile([this](Task *task){ scheduler.releaseTask(task); });
+
 	// Make workers work
 	this->work();
 
+	// Joins the compilers, already done since the workers wait for every task
+	program.wait();
+
+	// Wait for the writes behind
+	this->drain();
+
+	// Kernel times for the next rankings
+	program.measure();
+
 	// Release of cache entries
 	cache.freeEntries();
 }
@@ -510,6 +593,8 @@ void Runtime::reportEval() {
 	// Synchronizes all times up till the system level
 	clock.syncAll({ID_ALL,ID_ALL,ID_ALL});
 	const int W = conf.num_workers;
+	const int P = std::max(conf.num_prefetchers,1);
+	const int R = std::max(conf.num_writers,1);
 	const double V = clock.get(EVAL) / 100;
 	const double E = clock.get(EXEC) / 100;
 
@@ -532,6 +617,9 @@ void Runtime::reportEval() {
 	std::cerr << "  compute: " << clock.get(COMPUTE)/W/E << "%" << std::endl;
 	std::cerr << "  store:   " << clock.get(STORE)/W/E << "%" << std::endl;
 	std::cerr << "  notify:  " << clock.get(NOTIFY)/W/E << "%" << std::endl;
+	std::cerr << "  prefet:  " << clock.get(PREFETCH)/P/E << "%" << std::endl;
+	std::cerr << "  wbehind: " << clock.get(WBEHIND)/R/E << "%" << std::endl;
+	std::cerr << "  backpr:  " << clock.get(BACKPRES)/W/E << "%" << std::endl;
 	
 	std::cerr << "    read:  " << clock.get(READ)/W/E << "%" << std::endl;
 	std::cerr << "    send:  " << clock.get(SEND)/W/E << "%" << std::endl;
@@ -545,7 +633,18 @@ void Runtime::reportEval() {
 	std::cerr << "  loaded: " << clock.get(LOADED) << " (" << clock.get(NOT_LOADED) << ") " << clock.get(LOADED)/(double)L*100 << "%" << std::endl;
 	std::cerr << "  stored: " << clock.get(STORED) << " (" << clock.get(NOT_STORED) << ") " << clock.get(STORED)/(double)S*100 << "%" << std::endl;
 	std::cerr << "  computed: " << clock.get(COMPUTED) << " (" << clock.get(NOT_COMPUTED) << ") " << clock.get(COMPUTED)/(double)C*100 << "%" << std::endl;
+	std::cerr << "  stolen: " << clock.get(STOLEN) << " affinity: " << clock.get(AFFINITY) << " (window " << conf.affinity_window << ")" << std::endl;
 	std::cerr << "  discarded: " << clock.get(DISCARDED) << " evicted: " << clock.get(EVICTED) << std::endl;
+	std::cerr << "  replaced (" << cache.policyName() << "): " << clock.get(REPLACED) << std::endl;
+	for (auto &k : cache.classList())
+		std::cerr << "  class " << k.block_size/1024 << " KB: " << k.num_entry << " entries" << std::endl;
+	std::cerr << "  host hit: " << clock.get(HOST_HIT) << " miss: " << clock.get(HOST_MISS) << " evicted: " << clock.get(HOST_EVICTED) << std::endl;
+	std::cerr << "  result hit: " << clock.get(RESULT_HIT) << " miss: " << clock.get(RESULT_MISS) << " reused: " << clock.get(REUSED) << std::endl;
+	for (auto &s : cache.spillList()) {
+		const double MB = 1024*1024;
+		std::cerr << "  spill " << std::get<0>(s) << ": " << std::get<1>(s)/MB << " MB, ratio " << std::get<1>(s)/(double)std::get<2>(s) << std::endl;
+	}
+	std::cerr << "  prefetched: " << clock.get(PREFETCHED) << " hit: " << clock.get(PREFETCH_HIT) << " miss: " << clock.get(PREFETCH_MISS) << std::endl;
 
 	std::cerr << (char*)clenv.D(0).get(CL_DEVICE_NAME) << std::endl;
 }
@@ -15,6 +15,9 @@
 #include "Cache.hpp"
 #include "Scheduler.hpp"
 #include "Worker.hpp"
+#include "Prefetcher.hpp"
+#include "Writer.hpp"
+#include "IOThread.hpp"
 #include "Clock.hpp"
 #include "Config.hpp"
 #include "visitor/SimplifierOnline.hpp"
@@ -69,6 +72,7 @@ class Runtime
 
 	void clear(); // runtime structures are cleared
 	void work(); // stars a series of threads to work
+	void drain(); // waits for the writers to finish the pending writes
 	void reportEval(); // prints execution time whitin 'eval'
 	void reportOver(); // prints overall execution times
 
@@ -108,7 +112,12 @@ class Runtime
 	Cache cache; //!< Memory cache, allocates and releases memory (chunks 1xScript, subBuffers 1xeval)
 	Scheduler scheduler; //!< Job scheduler
 	std::vector<Worker> workers; //!< Vector of workers
+	std::vector<Prefetcher> prefetchers; //!< Vector of prefetchers
+	std::vector<Writer> writers; //!< Vector of writers
+	std::vector<IOThread> io_threads; //!< Vector of I/O threads
 	std::vector<std::unique_ptr<std::thread>> threads; //!< Vector of threads
+	std::vector<std::unique_ptr<std::thread>> writer_threads; //!< Vector of writer threads, outlive the workers
+	std::vector<std::unique_ptr<std::thread>> io_handles; //!< Threads of the I/O threads, join after the workers
 
 	OwnerNodeList node_list; //!< Full list of nodes added to the runtime during the script execution (EDAG)
 	OwnerGroupList group_list; //!< 1 fused list is valid for 1 evaluation (GDAG)
@@ -1,13 +1,19 @@
 /**
- * @file    Scheduler.cpp 
+ * @file    Scheduler.cpp
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: 'num_jobs' and 'waiters_job' are seq_cst, a worker about to park either sees the new jobs or is woken
+ * Note: thieves take the top job of the victim, the Order is kept locally but not across queues
+ * Note: 'pending_vers' is checked again under 'mtx_held', a job is never held after its task was released
+ * Note: prefetchers peek at the top jobs of each queue, and only after half their depth of queue changes
  */
 
 #include "Scheduler.hpp"
 #include "Program.hpp"
+#include "Cache.hpp"
 #include "Clock.hpp"
- 
+#include <algorithm>
+
 
 namespace map { namespace detail {
 
@@ -15,18 +21,32 @@ namespace map { namespace detail {
    Scheduler
  *************/
 
-Scheduler::Scheduler(Program &prog, Clock &clock, Config &conf)
+Scheduler::Scheduler(Program &prog, Cache &cache, Clock &clock, Config &conf)
 	: prog(prog)
+	, cache(cache)
 	, clock(clock)
 	, conf(conf)
 { }
 
 void Scheduler::clear() {
 	job_vec_vec = decltype(job_vec_vec)();
-	job_queue = decltype(job_queue)();
-	job_set = decltype(job_set)();
+	win_vec_vec = decltype(win_vec_vec)();
+	key_vec_vec = decltype(key_vec_vec)();
+	queue_list.reset();
+	stripe_list.reset();
+	park_list.reset();
+	parked.clear();
+	num_queue = 0;
+	stripe_mask = 0;
+	num_jobs = 0;
 	waiters_job = 0;
+	queue_version = 1; // 0 is the version of a prefetcher that never peeked
+	peek_version = 0;
+	peek_waiters = 0;
 	end = false;
+	held_jobs.clear();
+	pending_tasks = 0;
+	next_queue = 0;
 }
 
 void Scheduler::addInitialJobs() {
@@ -34,44 +54,105 @@ void Scheduler::addInitialJobs() {
 	std::vector<Job> job_vec;
 
 	assert(prog.taskList().size() > 0);
-	
+
+	// Allocates the queues, the stripes (power of 2) and the parking places of the workers
+	num_queue = conf.num_workers;
+	int num_stripe = 1;
+	while (num_stripe < 4*num_queue)
+		num_stripe *= 2;
+	stripe_mask = num_stripe - 1;
+
+	queue_list = std::unique_ptr<WorkQueue[]>(new WorkQueue[num_queue]);
+	stripe_list = std::unique_ptr<SetStripe[]>(new SetStripe[num_stripe]);
+	park_list = std::unique_ptr<Parking[]>(new Parking[num_queue]);
+	parked.reserve(num_queue);
+
 	// Filling 'job_vec' with all jobs of those tasks w/o prev dependencies
 	for (auto task : prog.taskList())
 		if (task->prevList().empty())
 			task->initialJobs(job_vec);
 
-	// Constructs 'job_queue' and 'job_set' from 'job_vec'
-	for (auto job : job_vec) {
-		job_queue.push(job);
-		job_set.insert(job);
+	// Tasks whose versions are not compiled yet, see Program::compile
+	for (auto task : prog.taskList())
+		if (task->pending_vers > 0)
+			pending_tasks++;
+
+	// Deals 'job_vec' round-robin among the queues, no worker runs yet
+	int queued = 0;
+	for (int i=0; i<job_vec.size(); i++) {
+		stripeOf(job_vec[i]).job_set.insert(job_vec[i]);
+		if (job_vec[i].task->pending_vers > 0) {
+			held_jobs[job_vec[i].task].push_back(job_vec[i]);
+			continue;
+		}
+		queue_list[queued++ % num_queue].job_queue.push(job_vec[i]);
 	}
+	num_jobs = queued;
+	next_queue = queued % num_queue;
 
-	// Allocates the 'job_vec' for the threads
+	// Allocates the 'job_vec', 'win_vec' and 'key_vec' for the threads
 	job_vec_vec.resize( conf.num_machines*conf.num_devices*conf.num_ranks );
+	win_vec_vec.resize( job_vec_vec.size() );
+	key_vec_vec.resize( job_vec_vec.size() );
 }
 
 Job Scheduler::getJob() {
 	TimedRegion region(clock,GET_JOB);
+	const int self = Tid.proj();
 	Job job;
 
 	while (true) {
-		std::unique_lock<std::mutex> lock(mtx); // thread-safe
-		
-		if (job_queue.empty()) {
-			waitForJob(lock);
-			if (end) {
-				job.task = nullptr;
-				return job;
-			}
-		} else {
-			job = job_queue.top();
-			job_queue.pop();
-			job_set.erase(job);
+		if (takeJob(queue_list[self],job) || stealJob(self,job)) {
+			notifyPeekers();
+			return job;
+		}
+		if (!parkWorker(self)) {
+			job.task = nullptr; // Exit point
 			return job;
 		}
 	}
 }
 
+bool Scheduler::tryJob(Job &job) {
+	TimedRegion region(clock,GET_JOB);
+	const int self = Tid.proj();
+
+	if (takeJob(queue_list[self],job) || stealJob(self,job)) {
+		notifyPeekers();
+		return true;
+	}
+	return false; // The caller has other work, it does not park
+}
+
+void Scheduler::moreJobs(const Job &job, std::vector<Job> &job_vec, int num) {
+	TimedRegion region(clock,GET_JOB);
+	WorkQueue &queue = queue_list[Tid.proj()];
+	std::lock_guard<std::mutex> lock(queue.mtx); // thread-safe, only this queue
+
+	// Scans a few jobs beyond 'num', the Order interleaves the tasks sharing a block
+	std::vector<Job> &win_vec = win_vec_vec[Tid.proj()];
+	win_vec.clear();
+	int taken = 0;
+
+	while (!queue.job_queue.empty() && taken < num && win_vec.size() < 4*num) {
+		Job next = queue.job_queue.top();
+		queue.job_queue.pop();
+		if (next.task != job.task) {
+			win_vec.push_back(next);
+			continue;
+		}
+		SetStripe &stripe = stripeOf(next);
+		std::lock_guard<std::mutex> set_lock(stripe.mtx);
+		stripe.job_set.erase(next);
+		job_vec.push_back(next);
+		taken++;
+	}
+
+	for (auto &other : win_vec)
+		queue.job_queue.push(other); // Back to the queue
+	num_jobs -= taken;
+}
+
 void Scheduler::notifyEnd(Job job) {
 	TimedRegion region(clock,NOTIFY);
 	// Prepares the 'job_vec' to be filled with new 'jobs'
@@ -83,29 +164,247 @@ void Scheduler::notifyEnd(Job job) {
 	addJobs(job_vec);
 }
 
-void Scheduler::waitForJob(std::unique_lock<std::mutex> &lock) {
+Scheduler::SetStripe& Scheduler::stripeOf(const Job &job) {
+	size_t h = job_hash()(job);
+	h *= 0x9E3779B97F4A7C15ull; // Fibonacci hashing
+	return stripe_list[(h >> 40) & stripe_mask];
+}
+
+bool Scheduler::takeJob(WorkQueue &queue, Job &job) {
+	std::lock_guard<std::mutex> lock(queue.mtx); // thread-safe, only this queue
+
+	JobQueue &job_queue = queue.job_queue;
+	if (job_queue.empty())
+		return false;
+
+	// Pops the window of the static order, the job with most resident inputs is picked (first one on ties)
+	std::vector<Job> &win_vec = win_vec_vec[Tid.proj()];
+	win_vec.clear();
+	int best = 0, best_score = -1;
+	bool full = false;
+
+	while (!job_queue.empty() && win_vec.size() < conf.affinity_window && !full) {
+		win_vec.push_back(job_queue.top());
+		job_queue.pop();
+		int score = (conf.affinity_window > 1) ? residency(win_vec.back(),full) : 0;
+		if (score > best_score) {
+			best = win_vec.size() - 1;
+			best_score = score;
+		}
+	}
+
+	job = win_vec[best];
+	for (int i=0; i<win_vec.size(); i++)
+		if (i != best)
+			job_queue.push(win_vec[i]); // Back to the queue
+	if (best > 0)
+		clock.incr(AFFINITY);
+
+	{ // Leaves the set while the queue is locked, a job added meanwhile is queued again
+		SetStripe &stripe = stripeOf(job);
+		std::lock_guard<std::mutex> set_lock(stripe.mtx);
+		stripe.job_set.erase(job);
+	}
+	num_jobs--;
+	return true;
+}
+
+int Scheduler::residency(const Job &job, bool &full) {
+	InKeyList &in_keys = key_vec_vec[Tid.proj()];
+	job.task->blocksToLoad(job.coord,in_keys);
+
+	int score = 0, total = 0;
+	for (auto &i : in_keys) {
+		if (std::get<1>(i) != HOLD_N)
+			continue; // Only blocks with N values live in the cache entries
+		total++;
+		if (cache.isResident(std::get<0>(i)))
+			score++;
+	}
+	full = (score == total); // Nothing better can be found
+	return score;
+}
+
+bool Scheduler::stealJob(int self, Job &job) {
+	for (int i=1; i<num_queue; i++) {
+		if (num_jobs == 0)
+			return false; // Nothing left to steal
+		if (takeJob(queue_list[(self+i) % num_queue],job)) {
+			clock.incr(STOLEN);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Scheduler::parkWorker(int self) {
 	//TimedRegion region(clock,WAIT_JOB);
+	std::unique_lock<std::mutex> lock(mtx_park); // thread-safe
+
+	if (end)
+		return false;
 
 	waiters_job++;
-	if (waiters_job == conf.num_workers) {
+	if (num_jobs > 0) { // Jobs were added meanwhile, retries
+		waiters_job--;
+		return true;
+	}
+
+	if (waiters_job == conf.num_workers && pending_tasks == 0) {
 		end = true;  // Last waiter activates exit
-		cv_job.notify_all();
+		for (int w : parked) {
+			park_list[w].awake = true;
+			park_list[w].cv.notify_one();
+		}
+		parked.clear();
+		lock.unlock();
+		notifyPeekers();
 	} else {
-		cv_job.wait(lock);
+		Parking &park = park_list[self];
+		park.awake = false;
+		parked.push_back(self);
+		park.cv.wait(lock,[&]{ return park.awake; });
 	}
+
 	waiters_job--;
+	return !end;
+}
+
+void Scheduler::wakeWorkers(int num) {
+	std::lock_guard<std::mutex> lock(mtx_park); // thread-safe
+
+	// Wakes only as many workers as new jobs, not all of them
+	while (num-- > 0 && !parked.empty()) {
+		int w = parked.back();
+		parked.pop_back();
+		park_list[w].awake = true;
+		park_list[w].cv.notify_one();
+	}
+}
+
+void Scheduler::notifyPeekers() {
+	if (conf.num_prefetchers == 0)
+		return; // Nobody peeks
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(mtx_peek); // thread-safe
+		queue_version++;
+		wake = end || (peek_waiters > 0 && queue_version - peek_version >= peekStride());
+	}
+	if (wake)
+		cv_peek.notify_all();
+}
+
+size_t Scheduler::peekStride() const {
+	// Half the depth has to change before peeking again, the rest of the last peek is still ahead
+	return std::max(1,conf.prefetch_depth/2);
+}
+
+bool Scheduler::holdJob(const Job &job) {
+	if (job.task->pending_vers == 0)
+		return false; // Fast path, built tasks are never held again
+
+	std::lock_guard<std::mutex> lock(mtx_held); // thread-safe
+	if (job.task->pending_vers == 0)
+		return false; // Released meanwhile
+	held_jobs[job.task].push_back(job);
+	return true;
+}
+
+void Scheduler::releaseTask(Task *task) {
+	std::vector<Job> job_vec;
+	int first;
+
+	{ // The compiler thread has no queue of its own, the held jobs are dealt round-robin
+		std::lock_guard<std::mutex> lock(mtx_held); // thread-safe
+		auto it = held_jobs.find(task);
+		if (it != held_jobs.end()) {
+			job_vec.swap(it->second);
+			held_jobs.erase(it);
+		}
+		first = next_queue;
+		next_queue = (next_queue + job_vec.size()) % num_queue;
+	}
+
+	for (int i=0; i<job_vec.size(); i++) {
+		WorkQueue &queue = queue_list[(first + i) % num_queue];
+		std::lock_guard<std::mutex> lock(queue.mtx); // thread-safe, only this queue
+		queue.job_queue.push(job_vec[i]); // Already in the set
+		num_jobs++;
+	}
+
+	// Decremented after queuing, the last waiter would otherwise end the evaluation
+	bool last = (--pending_tasks == 0);
+	if (waiters_job > 0)
+		wakeWorkers(last ? std::max<int>(job_vec.size(),1) : job_vec.size());
+	if (!job_vec.empty())
+		notifyPeekers();
 }
 
 void Scheduler::addJobs(const std::vector<Job> &job_vec) {
-	std::lock_guard<std::mutex> lock(mtx); // thread-safe
-	for (auto job : job_vec) {
-		// Checks uniqueness before inserting
-		if (job_set.find(job) == job_set.end()) {
-			job_queue.push(job);
-			job_set.insert(job);
+	WorkQueue &queue = queue_list[Tid.proj()];
+	int added = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mtx); // thread-safe, only this queue
+		for (auto job : job_vec) {
+			// Checks uniqueness before inserting
+			SetStripe &stripe = stripeOf(job);
+			std::lock_guard<std::mutex> set_lock(stripe.mtx);
+			if (stripe.job_set.insert(job).second && !holdJob(job)) {
+				queue.job_queue.push(job);
+				added++;
+			}
+		}
+		num_jobs += added;
+	}
+
+	if (added == 0)
+		return;
+	if (waiters_job > 0)
+		wakeWorkers(added);
+	notifyPeekers();
+}
+
+bool Scheduler::peekJobs(std::vector<Job> &job_vec, int depth, size_t &version) {
+	{
+		std::unique_lock<std::mutex> lock(mtx_peek); // thread-safe
+
+		// Waits until enough of the queues changed since the last peek, or until the end
+		peek_waiters++;
+		cv_peek.wait(lock,[&]{ return end || version == 0 || queue_version - version >= peekStride(); });
+		peek_waiters--;
+		if (end)
+			return false; // Exit point for the prefetchers
+		version = peek_version = queue_version;
+	}
+
+	// Gathers the top 'depth' jobs of each queue, walking its heap best-first
+	auto cmp = [](const Job &lhs, const Job &rhs){ return lhs.order < rhs.order; };
+	std::vector<Job> top_vec; // At most 'depth' per queue
+	top_vec.reserve(num_queue*depth);
+
+	for (int i=0; i<num_queue; i++) {
+		std::lock_guard<std::mutex> lock(queue_list[i].mtx);
+		auto &vec = queue_list[i].job_queue.container();
+		auto worse = [&](int lhs, int rhs){ return cmp(vec[rhs],vec[lhs]); };
+		std::priority_queue<int,std::vector<int>,decltype(worse)> front(worse); // Heap indices
+		if (!vec.empty())
+			front.push(0);
+		for (int n=0; n<depth && !front.empty(); n++) {
+			int k = front.top();
+			front.pop();
+			top_vec.push_back(vec[k]);
+			if (2*k+1 < vec.size()) front.push(2*k+1);
+			if (2*k+2 < vec.size()) front.push(2*k+2);
 		}
 	}
-	cv_job.notify_all();
+
+	// Copies the next 'depth' jobs in priority order, without removing them
+	job_vec.resize(std::min<size_t>(depth,top_vec.size()));
+	std::partial_sort_copy(top_vec.begin(),top_vec.end(),job_vec.begin(),job_vec.end(),cmp);
+
+	return true;
 }
 
 void Scheduler::print() {
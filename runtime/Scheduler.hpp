@@ -1,7 +1,16 @@
 /**
- * @file    Scheduler.hpp 
+ * @file    Scheduler.hpp
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: every worker owns a queue of jobs sorted by Order, the new jobs go to the queue of the worker adding them
+ * Note: workers with an empty queue steal from the others, and park only when no queue has jobs
+ * Note: the uniqueness set is striped by 'job_hash'. Lock order is queue --> set stripe, never two queues
+ * Note: the evaluation ends when all workers are parked and no jobs are left, as with the former global queue
+ * Note: within the first conf.affinity_window jobs of a queue, the one with most inputs resident in the Cache goes first
+ * Note: tryJob() never parks, workers with jobs in flight retire them instead of waiting
+ * Note: moreJobs() hands out further jobs of the same task from the own queue, to be computed in one batched launch
+ * Note: jobs of tasks still compiling are held apart, releaseTask() deals them among the queues once the task is built
+ *
  * TODO: the scheduling would be more efficient if the jobs are sorted in the queue near by their dependencies
  *       e.g. for two series of conv in parallel, better compute a whole series first, instead of interleaving
  * TODO: it will be necessary to have individual queues per device to keep locality
@@ -12,9 +21,13 @@
 
 #include "Config.hpp"
 #include "Job.hpp"
+#include "Block.hpp"
 #include <vector>
 #include <queue>
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 
@@ -22,42 +35,103 @@
 namespace map { namespace detail {
 
 class Program; // Forward declaration
+class Cache; // Forward declaration
 class Clock; // Forward declaration
 
+/*
+ * Priority queue of jobs, exposing its container to peek at the upcoming jobs
+ */
+struct JobQueue : public std::priority_queue<Job,std::vector<Job>,job_cmp> {
+	const std::vector<Job>& container() const { return c; }
+};
+
 
 /*
  *
  */
 class Scheduler
 {
+	/*
+	 * Queue owned by one worker
+	 */
+	struct WorkQueue {
+		std::mutex mtx;
+		JobQueue job_queue; //!< Jobs ready to be issued, sorted by Order
+	};
+
+	/*
+	 * Stripe of the uniqueness set
+	 */
+	struct SetStripe {
+		std::mutex mtx;
+		std::unordered_set<Job,job_hash,job_equal> job_set; //!< Queued jobs (necessary for Spreading)
+	};
+
+	/*
+	 * Parking place of one idle worker
+	 */
+	struct Parking {
+		std::condition_variable cv;
+		bool awake;
+	};
+
   public:
-  	Scheduler(Program &prog, Clock &clock, Config &conf);
+  	Scheduler(Program &prog, Cache &cache, Clock &clock, Config &conf);
 
   	void clear();
 	void print();
-	
+
 	void addInitialJobs();
 	Job getJob();
+	bool tryJob(Job &job);
+	void moreJobs(const Job &job, std::vector<Job> &job_vec, int num);
 	void notifyEnd(Job job);
+	bool peekJobs(std::vector<Job> &job_vec, int depth, size_t &version);
+	void releaseTask(Task *task);
 
   private:
-  	void waitForJob(std::unique_lock<std::mutex> &lock);
+	SetStripe& stripeOf(const Job &job);
+	bool holdJob(const Job &job);
+	bool takeJob(WorkQueue &queue, Job &job);
+	int residency(const Job &job, bool &full);
+	bool stealJob(int self, Job &job);
+	bool parkWorker(int self);
+	void wakeWorkers(int num);
+	void notifyPeekers();
+	size_t peekStride() const;
 	void addJobs(const std::vector<Job> &job);
 
   private:
   	Program &prog; // Aggregate
+  	Cache &cache; // Aggregate
   	Clock &clock; // Aggregate
   	Config &conf; // Aggregate
 
   	std::vector<std::vector<Job>> job_vec_vec; // Allocates one job_vec per thread
+  	std::vector<std::vector<Job>> win_vec_vec; // Window of candidate jobs, one per thread
+  	std::vector<InKeyList> key_vec_vec; // Input keys of the candidates, one per thread
+
+	std::unique_ptr<WorkQueue[]> queue_list; //!< One queue per worker, indexed by Tid.proj()
+	std::unique_ptr<SetStripe[]> stripe_list; //!< Striped uniqueness set
+	int num_queue, stripe_mask;
+	std::atomic<int> num_jobs; //!< Jobs in all queues, checked before parking
+
+	std::mutex mtx_park;
+	std::unique_ptr<Parking[]> park_list; //!< Targeted wakeups, one per worker
+	std::vector<int> parked; //!< Workers waiting for jobs
+	std::atomic<int> waiters_job;
+	std::atomic<bool> end;
 
-	std::priority_queue<Job,std::vector<Job>,job_cmp> job_queue; // Jobs ready to be issued
-	std::unordered_set<Job,job_hash,job_cmp> job_set; // Tracks uniqueness (necessary for Spreading)
+	std::mutex mtx_held;
+	std::unordered_map<Task*,std::vector<Job>> held_jobs; //!< Jobs of the tasks still compiling
+	std::atomic<int> pending_tasks; //!< Tasks still compiling, the evaluation does not end before 0
+	int next_queue; //!< Round-robin queue of the released jobs
 
-	std::mutex mtx;
-	std::condition_variable cv_job;
-	int waiters_job;
-	bool end;
+	std::mutex mtx_peek;
+	std::condition_variable cv_peek;
+	size_t queue_version; // Changes every time a queue does, wakes the prefetchers
+	size_t peek_version; // Version seen by the last peek
+	int peek_waiters; // Prefetchers waiting in peekJobs
 };
 
 } } // namespace map::detail
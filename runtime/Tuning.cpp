@@ -0,0 +1,94 @@
+/**
+ * @file    Tuning.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: a missing or unreadable tuning file is not an error, the skeletons keep their default group sizes
+ * Note: the candidates are powers of 2, as required by the reductions of the zonal skeletons
+ */
+
+#include "Tuning.hpp"
+#include "Version.hpp"
+#include "task/Task.hpp"
+#include "Persist.hpp"
+#include <fstream>
+#include <sstream>
+
+
+namespace map { namespace detail {
+
+Tuning::Tuning(Config &conf)
+	: conf(conf)
+	, loaded(false)
+{ }
+
+void Tuning::load() {
+	if (loaded)
+		return; // Only once, later runs are merged in memory
+	loaded = true;
+
+	std::string dir = persistDir();
+	if (dir.empty())
+		return; // Refused, the versions are tuned again and not saved
+	std::ifstream in(dir + "/" + conf.tuning_path);
+	uint64_t hash;
+	int gs0, gs1;
+	while (in >> hash >> gs0 >> gs1)
+		size_hash[hash] = BlockSize{gs0,gs1};
+}
+
+void Tuning::save() const {
+	std::string dir = persistDir();
+	if (dir.empty())
+		return; // @ not writable, the tuning stays in memory
+	std::ostringstream out;
+	for (auto &it : size_hash)
+		out << it.first << " " << it.second[0] << " " << it.second[1] << "\n";
+	persistFile(dir + "/" + conf.tuning_path, out.str()); // concurrent runs replace the whole file, never mix it
+}
+
+uint64_t Tuning::key(const Version *ver) const {
+	cle::Device dev = ver->device();
+	return fnv1a( ver->signature() + (const char*)dev.get(CL_DEVICE_NAME) );
+}
+
+bool Tuning::find(const Version *ver, BlockSize &group_size) const {
+	auto it = size_hash.find(key(ver));
+	if (it == size_hash.end())
+		return false;
+	group_size = it->second;
+	return true;
+}
+
+void Tuning::update(const Version *ver, const BlockSize &group_size) {
+	size_hash[key(ver)] = group_size;
+}
+
+std::vector<BlockSize> Tuning::candidates(const Version *ver) const {
+	std::vector<BlockSize> cand, fit;
+
+	if (ver->deviceType() == DEV_CPU) // One work-item per core, row-major shapes follow the cache lines
+		cand = { {64,1}, {128,1}, {256,1}, {512,1}, {8,8}, {16,16} };
+	else // Warps / wavefronts of 32 and 64
+		cand = { {16,16}, {32,8}, {64,4}, {8,32}, {32,4}, {8,8}, {32,16} };
+
+	// Within the limits of the device and the work size, the current group size is not repeated
+	cle::Device dev = ver->device();
+	size_t max_group = *(size_t*) dev.get(CL_DEVICE_MAX_WORK_GROUP_SIZE);
+	const size_t *item_ptr = (const size_t*) dev.get(CL_DEVICE_MAX_WORK_ITEM_SIZES);
+	size_t max_item[2] = {item_ptr[0],item_ptr[1]}; // get() reuses its buffer
+	BlockSize ws = ver->task->blocksize();
+	ws[0] = (ws[0] - 1) / ver->vec_width + 1; // Vector kernels launch fewer work-items, see Task::computeVersion
+
+	for (auto &gs : cand) {
+		if (all(gs == ver->groupsize()))
+			continue;
+		if (prod(gs) > max_group || gs[0] > max_item[0] || gs[1] > max_item[1])
+			continue;
+		if (gs[0] > ws[0] || gs[1] > ws[1])
+			continue;
+		fit.push_back(gs);
+	}
+	return fit;
+}
+
+} } // namespace map::detail
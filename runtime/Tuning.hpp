@@ -0,0 +1,49 @@
+/**
+ * @file    Tuning.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: group sizes tuned in earlier runs, persisted to conf.tuning_path in the per-user directory
+ * Note: versions are identified by the FNV-1a hash of their signature and device name, one line per version "hash gs0 gs1"
+ * Note: with conf.autotuning, untuned versions are benchmarked against candidates() during the first evaluation
+ */
+
+#ifndef MAP_RUNTIME_TUNING_HPP_
+#define MAP_RUNTIME_TUNING_HPP_
+
+#include "Config.hpp"
+#include "../util/util.hpp"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+namespace map { namespace detail {
+
+struct Version; // forward declaration
+
+class Tuning
+{
+  public:
+	Tuning(Config &conf);
+	Tuning(const Tuning&) = delete;
+	Tuning& operator=(const Tuning&) = delete;
+
+	void load();
+	void save() const;
+	bool find(const Version *ver, BlockSize &group_size) const;
+	void update(const Version *ver, const BlockSize &group_size);
+	std::vector<BlockSize> candidates(const Version *ver) const;
+
+  private:
+	uint64_t key(const Version *ver) const;
+
+	Config &conf; // Aggregate
+
+	std::unordered_map<uint64_t,BlockSize> size_hash; //!< Hash of the version signature and device --> group size
+	bool loaded;
+};
+
+} } // namespace map::detail
+
+#endif
@@ -7,6 +7,7 @@
 #include "Version.hpp"
 #include "task/Task.hpp"
 #include "Runtime.hpp"
+#include "KernelCache.hpp"
 #include <fstream>
 
 namespace map { namespace detail {
@@ -15,6 +16,15 @@ Version::Version(Task *task, cle::Device dev, std::string detail)
 	: task(task)
 	, dev(dev)
 	, detail(detail)
+	, vec_width(1)
+	, batched(false)
+	, prebuilt(false)
+	, tune_size()
+	, fits(false)
+	, tune_list()
+	, tune_next(0)
+	, krn_nsec(0)
+	, krn_jobs(0)
 {
 	// Filling 'dev_type'
 	cl_device_type type = *(cl_device_type*) dev.get(CL_DEVICE_TYPE);
@@ -48,24 +58,13 @@ const NumBlock& Version::numgroup() const {
 	return num_group;
 }
 
-void Version::createProgram() {
-	cle::Context ctx = dev.C(0); // Devices only have 1 context
-	const char *code_str = code.data();
-	size_t code_length = code.size();
-	cl_int err;
-
-	cl_program cl_prg = clCreateProgramWithSource(*ctx, 1, &code_str, &code_length, &err);
-	cle::clCheckError(err);
-	int id = ctx.addTask(cl_prg);
-	this->tsk = ctx.T(id);
+std::string Version::kernelName() const {
+	size_t hash = std::hash<std::string>()( signature() );
+	return "krn" + std::to_string(hash);
 }
 
-void Version::compileProgram() {
+std::string Version::buildFlags() const {
 	std::string flags;
-	cl_int err;
-
-	size_t hash = std::hash<std::string>()( signature() );
-	std::string kernel_name = "krn" + std::to_string(hash);
 
 	// Includes
 	#ifdef RAND123
@@ -86,27 +85,86 @@ void Version::compileProgram() {
 	// Debug
 	bool debug = false; // @ only with Intel
 	if (debug) {
-		std::string cl_file = "/tmp/" + kernel_name + ".cl";
+		std::string cl_file = "/tmp/" + kernelName() + ".cl";
 		flags += " -g -s " + cl_file;
 		std::ofstream of(cl_file);
 	    of << code;
 	    of.close();
 	}
 
-	// Compiling to machine code
-	err = clBuildProgram(*tsk, 0, NULL, flags.c_str(), NULL, NULL);
-
-	if (err != CL_SUCCESS) {
-		cl_build_status status;
-		clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
-		size_t log_size;
-		clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-		char *log = new char [log_size+1];
-		clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-		std::cout << status << ":" << log_size << std::endl << log << std::endl;
-		delete [] log;
+	return flags;
+}
+
+void Version::createProgram(const KernelCache &kcache) {
+	cle::Context ctx = dev.C(0); // Devices only have 1 context
+	std::string flags = buildFlags();
+	std::vector<unsigned char> bin;
+	cl_program cl_prg = NULL;
+	cl_int err;
+
+	// Binary compiled by an earlier run, linked later by the compilers (see compileProgram)
+	prebuilt = false;
+	if (kcache.load(this,flags,bin)) {
+		const unsigned char *bin_ptr = bin.data();
+		size_t bin_size = bin.size();
+		cl_int status;
+		cl_prg = clCreateProgramWithBinary(*ctx, 1, &*dev, &bin_size, &bin_ptr, &status, &err);
+		if (err == CL_SUCCESS && status == CL_SUCCESS) {
+			prebuilt = true;
+		} else if (cl_prg != NULL) { // The driver rejected it, falls back to source
+			clReleaseProgram(cl_prg);
+			cl_prg = NULL;
+		}
+	}
+
+	if (!prebuilt) {
+		const char *code_str = code.data();
+		size_t code_length = code.size();
+		cl_prg = clCreateProgramWithSource(*ctx, 1, &code_str, &code_length, &err);
+		cle::clCheckError(err);
+	}
+
+	int id = ctx.addTask(cl_prg);
+	this->tsk = ctx.T(id);
+}
+
+void Version::compileProgram(const KernelCache &kcache) {
+	std::string kernel_name = kernelName();
+	std::string flags = buildFlags();
+	cl_int err;
+
+	// Linking the binary loaded from the kernel cache, the driver might still reject it
+	if (prebuilt) {
+		err = clBuildProgram(*tsk, 1, &*dev, flags.c_str(), NULL, NULL);
+		if (err != CL_SUCCESS) { // Falls back to source, the task has no kernels yet
+			const char *code_str = code.data();
+			size_t code_length = code.size();
+			cl_program cl_prg = clCreateProgramWithSource(*dev.C(0), 1, &code_str, &code_length, &err);
+			cle::clCheckError(err);
+			clReleaseProgram(*tsk);
+			tsk.setProgram(cl_prg);
+			prebuilt = false;
+		}
+	}
+
+	// Compiling to machine code, unless it was loaded from the kernel cache
+	if (!prebuilt) {
+		err = clBuildProgram(*tsk, 0, NULL, flags.c_str(), NULL, NULL);
+
+		if (err != CL_SUCCESS) {
+			cl_build_status status;
+			clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
+			size_t log_size;
+			clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+			char *log = new char [log_size+1];
+			clGetProgramBuildInfo(*tsk, *dev, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+			std::cout << status << ":" << log_size << std::endl << log << std::endl;
+			delete [] log;
+		}
+		cle::clCheckError(err);
+
+		kcache.store(this,flags,*tsk);
 	}
-	cle::clCheckError(err);
 
 	// Creates 1 kernel per worker, because cl_kernels aren't thread-safe
 	for (int j=0; j<Runtime::getConfig().num_ranks; j++) {
@@ -114,6 +172,22 @@ void Version::compileProgram() {
 		cle::clCheckError(err);
 		tsk.addKernel(clkrn);
 	}
+
+	// The batched kernels follow, K(num_ranks + rank)
+	for (int j=0; batched && j<Runtime::getConfig().num_ranks; j++) {
+		cl_kernel clkrn = clCreateKernel(*tsk, (kernel_name + "_B").c_str(), &err);
+		cle::clCheckError(err);
+		tsk.addKernel(clkrn);
+	}
+
+	// The registers or local memory of the kernel might not allow the group size, only matters to the candidates
+	// Note: 'fits' goes last, the workers take a candidate once all its kernels (batched too) are there
+	size_t krn_group;
+	cl_ulong krn_local, dev_local;
+	clGetDeviceInfo(*dev, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &dev_local, NULL); // not dev.get(), many compilers
+	clGetKernelWorkGroupInfo(*tsk.K(0), *dev, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &krn_group, NULL);
+	clGetKernelWorkGroupInfo(*tsk.K(0), *dev, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(cl_ulong), &krn_local, NULL);
+	fits = (prod(group_size) <= krn_group && krn_local <= dev_local);
 }
 
 void Version::copyParams(Version *ver) {
@@ -124,7 +198,27 @@ void Version::copyParams(Version *ver) {
 	shared_size = ver->shared_size;
 	group_size = ver->group_size;
 	num_group = ver->num_group;
+	vec_width = ver->vec_width;
 	extra_arg = ver->extra_arg;
+	batched = ver->batched;
+	prebuilt = ver->prebuilt;
+	tune_size = ver->tune_size;
+	fits = ver->fits.load();
+}
+
+const Version* Version::variant() const {
+	if (tune_list.empty())
+		return this;
+	// While tuning, the launches rotate among this version and the candidates built that fit
+	unsigned int i = tune_next++ % (tune_list.size() + 1);
+	if (i == 0 || !tune_list[i-1]->fits)
+		return this;
+	return tune_list[i-1].get();
+}
+
+void Version::addTime(double sec, int jobs) const {
+	krn_nsec += sec * 1e9;
+	krn_jobs += jobs;
 }
 
 } } // namespace map::detail
@@ -11,11 +11,15 @@
 #include "../cle/cle.hpp"
 #include "../util/Array.hpp"
 #include <string>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 
 namespace map { namespace detail {
 
 struct Task; // forward declaration
+class KernelCache; // forward declaration
 
 /*
  * Code Version
@@ -31,10 +35,14 @@ struct Version {
 	const BlockSize& groupsize() const;
 	const NumBlock& numgroup() const;
 	std::string signature() const;
-	void createProgram();
-	void compileProgram();
+	std::string kernelName() const;
+	std::string buildFlags() const;
+	void createProgram(const KernelCache &kcache);
+	void compileProgram(const KernelCache &kcache);
 
 	void copyParams(Version *ver);
+	const Version* variant() const;
+	void addTime(double sec, int jobs) const;
 
   // vars
 	Task *task;
@@ -45,12 +53,23 @@ struct Version {
 
 	std::string code; //!< Kernel code
 	cle::Task tsk; //!< cle::Task
+	bool prebuilt; //!< Program created from a KernelCache binary, only linked by compileProgram
 	
 	int shared_size; //!< Shared memory size
 	BlockSize group_size; //!< Work group size
 	NumBlock num_group; //!< Work group number
+	int vec_width; //!< Cells per work-item along the 1st dimension, see CpuLocalSkeleton
+	BlockSize tune_size; //!< Group size from the Tuning or of a candidate, None keeps the skeleton default
+	std::atomic<bool> fits; //!< Built and accepting the group size, see compileProgram
+	std::vector<std::unique_ptr<Version>> tune_list; //!< Candidates with other group sizes, benchmarked in this evaluation
+	mutable std::atomic<unsigned int> tune_next; //!< Round-robin among this version and its candidates
 	
+	bool batched; //!< Also has a kernel computing several blocks per launch, see LocalSkeleton
+
 	std::vector<int> extra_arg; //!< @ Extra arguments needed by the skeleton
+
+	mutable std::atomic<long> krn_nsec; //!< Kernel time measured in this evaluation, feeds the Profile
+	mutable std::atomic<long> krn_jobs; //!< Jobs measured in this evaluation
 };
 
 typedef std::vector<std::unique_ptr<Version>> OwnerVersionList;
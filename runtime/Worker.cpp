@@ -2,7 +2,7 @@
  * @file    Worker.cpp 
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
- * TODO: the prediction should happens before any 'data block' is read from disk, only with the 'data stats'
+ * Note: input blocks the file stats mark as constant are fixed before being read, see Cache::predictInput
  * TODO: for more dynamism, worker should analyse / fuse / compile online ('runtime approach to map algebra')
  */
 
@@ -11,7 +11,9 @@
 #include "Scheduler.hpp"
 #include "Clock.hpp"
 #include "task/Task.hpp"
+#include "Runtime.hpp"
 #include "visitor/Predictor.hpp"
+#include <algorithm>
 
 
 namespace map { namespace detail {
@@ -25,15 +27,13 @@ Worker::Worker(Cache &cache, Scheduler &sche, Clock &clock, Config &conf)
 	, sche(sche)
 	, clock(clock)
 	, conf(conf)
-{
-	in_keys.reserve(conf.max_in_block);
-	in_blk.reserve(conf.max_in_block);
-	out_keys.reserve(conf.max_in_block);
-	out_blk.reserve(conf.max_in_block);
-}
+	, head(0)
+	, num_flight(0)
+{ }
 
 void Worker::work(ThreadId thread_id) {
 	Tid = thread_id; // Local thread id initialization
+	allocStages();
 	
 	// @@ SymLoop 'condition' + 'unrolling' needs to happen at local level
 	// the worker needs to walk the nodes and make more decisions
@@ -43,57 +43,197 @@ void Worker::work(ThreadId thread_id) {
 
 	while (true) // Worker loop
 	{
-		Job job = sche.getJob();
-		
-		if (job.task == nullptr) break; // Exit point
+		Job job;
+
+		if (num_flight == 0) {
+			job = sche.getJob(); // Parks when there are no jobs
+			if (job.task == nullptr) break; // Exit point
+		} else if (num_flight == stage_list.size() || !sche.tryJob(job)) {
+			retire(); // The pipeline is full, or no jobs are ready meanwhile
+			continue;
+		}
 			//std::cout << job.task->id() << job.coord << std::endl;
-		load(job);
 
-		compute(job);
-		
-		store(job);
-		
-		sche.notifyEnd(job);
+		Stage &stage = stage_list[(head + num_flight) % stage_list.size()];
+
+		// More jobs of the same task, when its kernel can compute them in one launch
+		stage.job_vec.clear();
+		stage.job_vec.push_back(job);
+		int num = std::min(job.task->batchSize(),cache.batchLimit());
+		if (num > 1 && job.task->version(DEV_ALL,"")->batched)
+			sche.moreJobs(job,stage.job_vec,num-1);
+
+		for (int i=0; i<stage.job_vec.size(); i++)
+			load(stage.job_vec[i],stage.base+i);
+
+		compute(stage);
+
+		if (stage.event != nullptr)
+			num_flight++; // Stored when retired
+		else
+			finish(stage);
 	}
+
+	assert(num_flight == 0);
+	freeStages();
+}
+
+void Worker::allocStages() {
+	const int depth = conf.pipeline_depth;
+	const int slots = std::max(1,cache.batchLimit());
+
+	in_keys.resize(depth*slots);
+	in_blk.resize(depth*slots);
+	out_keys.resize(depth*slots);
+	out_blk.resize(depth*slots);
+	reused.assign(depth*slots,0);
+	for (int i=0; i<depth*slots; i++) {
+		in_keys[i].reserve(conf.max_in_block);
+		in_blk[i].reserve(conf.max_in_block);
+		out_keys[i].reserve(conf.max_in_block);
+		out_blk[i].reserve(conf.max_in_block);
+	}
+
+	stage_list.resize(depth);
+	head = num_flight = 0;
+
+	for (int s=0; s<depth; s++) {
+		Stage &stage = stage_list[s];
+		stage.job_vec.reserve(slots);
+		stage.base = s*slots;
+		stage.event = nullptr;
+		stage.desc_mem = nullptr;
+		if (slots > 1) { // Descriptor of the batched launches, sized for the largest batch
+			cle::Context ctx = Runtime::getOclEnv().D(Tid.dev()).C(0);
+			size_t size = slots * (2 + conf.max_in_block + conf.max_out_block) * sizeof(int);
+			cl_int err;
+			stage.desc_mem = clCreateBuffer(*ctx, CL_MEM_READ_ONLY, size, nullptr, &err);
+			cle::clCheckError(err);
+		}
+	}
+}
+
+void Worker::freeStages() {
+	for (auto &stage : stage_list)
+		if (stage.desc_mem != nullptr)
+			clReleaseMemObject(stage.desc_mem);
+	stage_list.clear();
 }
 
-void Worker::load(Job job) {
+void Worker::load(Job job, int slot) {
 	TimedRegion region(clock,LOAD); // Timed function
 
 	job.task->preLoad(job.coord);
 
-	job.task->blocksToLoad(job.coord,in_keys);
-	cache.retainInputBlocks(in_keys,in_blk);
+	job.task->blocksToLoad(job.coord,in_keys[slot]);
+	job.task->blocksToStore(job.coord,out_keys[slot]);
+	cache.retainOutputBlocks(out_keys[slot],out_blk[slot]);
 
-	job.task->blocksToStore(job.coord,out_keys);
-	cache.retainOutputBlocks(out_keys,out_blk);
+	// Reuses the outputs kept by previous evaluations, when all of them are found the inputs are not loaded
+	reused[slot] = cache.reuseOutputs(out_blk[slot]);
+	if (reused[slot]) {
+		in_blk[slot].clear();
+		cache.skipInputBlocks(in_keys[slot]);
+	} else {
+		cache.retainInputBlocks(in_keys[slot],in_blk[slot]);
+	}
 }
 
-void Worker::store(Job job) {
+void Worker::store(Job job, int slot) {
 	TimedRegion region(clock,STORE); // Timed function
 
-	cache.releaseInputBlocks(in_blk);
-	cache.releaseOutputBlocks(out_blk,out_keys);
+	cache.releaseInputBlocks(in_blk[slot]);
+	cache.releaseOutputBlocks(out_blk[slot],out_keys[slot]);
 
 	job.task->postStore(job.coord);
 }
 
-void Worker::compute(Job job) {
+void Worker::compute(Stage &stage) {
 	TimedRegion region(clock,COMPUTE); // Timed function
+	Task *task = stage.job_vec.front().task;
+	cl_mem bat_chunk = nullptr, chunk;
+	bool launched = false;
+
+	bat_coord.clear();
+	bat_in.clear();
+	bat_out.clear();
+
+	for (int j=0; j<stage.job_vec.size(); j++) {
+		Job job = stage.job_vec[j];
+		int i = stage.base + j;
+
+		// Outputs reused at load time, see load
+		if (reused[i]) {
+			clock.incr(NOT_COMPUTED);
+			continue;
+		}
+
+		 // @ tries to predict the result according to some fixed inputs
+		Predictor predictor(job.task->base_group);
+		if (predictor.predict(job.coord,in_blk[i],out_blk[i])) {
+				//std::cout << job.task->id() << job.coord << std::endl;
+			clock.incr(NOT_COMPUTED);
+			continue;
+		} else {
+			clock.incr(COMPUTED);
+		}
+
+		job.task->preCompute(job.coord,in_blk[i],out_blk[i]);
+
+		// Batchable jobs wait for the others, all in the same chunk
+		bool batch = stage.job_vec.size() > 1 && job.task->batchable(in_blk[i],out_blk[i],chunk);
+		if (batch && (bat_chunk == nullptr || bat_chunk == chunk)) {
+			bat_chunk = chunk;
+			bat_coord.push_back(job.coord);
+			bat_in.push_back(&in_blk[i]);
+			bat_out.push_back(&out_blk[i]);
+			continue;
+		}
+
+		job.task->compute(job.coord,in_blk[i],out_blk[i]);
+		job.task->postCompute(job.coord,in_blk[i],out_blk[i]);
+		launched = true;
+	}
 
-	 // @ tries to predict the result according to some fixed inputs
-	Predictor predictor(job.task->base_group);
-	if (predictor.predict(job.coord,in_blk,out_blk)) {
-			//std::cout << job.task->id() << job.coord << std::endl;
-		clock.incr(NOT_COMPUTED);
-		return;
-	} else {
-		clock.incr(COMPUTED);
+	if (!bat_coord.empty()) {
+		if (bat_coord.size() == 1)
+			task->compute(bat_coord[0],*bat_in[0],*bat_out[0]);
+		else
+			task->computeBatch(bat_coord,bat_in,bat_out,stage.desc_mem,stage.desc);
+		for (int k=0; k<bat_coord.size(); k++)
+			task->postCompute(bat_coord[k],*bat_in[k],*bat_out[k]);
+		launched = true;
 	}
 
-	job.task->preCompute(job.coord,in_blk,out_blk);
-	job.task->compute(job.coord,in_blk,out_blk);
-	job.task->postCompute(job.coord,in_blk,out_blk);
+	// Pipelined kernels are still running, the marker completes after all of them
+	stage.event = nullptr;
+	if (launched && task->pipelined()) {
+		cle::Queue que = Runtime::getOclEnv().D(Tid.dev()).Q(Tid.rnk());
+		cl_int err = clEnqueueMarkerWithWaitList(*que, 0, nullptr, &stage.event);
+		cle::clCheckError(err);
+	}
+}
+
+void Worker::retire() {
+	Stage &stage = stage_list[head];
+	{
+		TimedRegion region(clock,COMPUTE);
+		cl_int err = clWaitForEvents(1,&stage.event);
+		cle::clCheckError(err);
+		clReleaseEvent(stage.event);
+		stage.event = nullptr;
+	}
+	finish(stage);
+	head = (head + 1) % stage_list.size();
+	num_flight--;
+}
+
+void Worker::finish(Stage &stage) {
+	for (int j=0; j<stage.job_vec.size(); j++)
+		store(stage.job_vec[j],stage.base+j);
+	
+	for (auto &done : stage.job_vec)
+		sche.notifyEnd(done);
 }
 
 } } // namespace map::detail
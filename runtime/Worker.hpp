@@ -3,6 +3,9 @@
  * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
  * NOTE: there is one worker per physical thread. Tid = per thread local storage for the ID = {node,device,rank}
+ * Note: a worker takes up to Cache::batchLimit() jobs of the same task, those batchable are computed in one launch
+ * Note: the jobs taken at once form a stage. Pipelined tasks leave their kernels in flight, up to conf.pipeline_depth
+ *       stages, while the worker loads the next one. Stages retire in order: wait, store, notify
  *
  * TODO: statistics at block level can be used to speed up the execution (e.g. if max==min -> all values are same)
  */
@@ -16,6 +19,7 @@
 #include "ThreadId.hpp"
 #include "Config.hpp"
 #include <vector>
+#include <cstdint>
 
 
 namespace map { namespace detail {
@@ -38,9 +42,26 @@ class Worker
 	Worker& operator=(Worker&&) = default;
 
 	void work(ThreadId thread_id);
-	void load(Job job);
-	void store(Job job);
-	void compute(Job job);
+	void load(Job job, int slot);
+	void store(Job job, int slot);
+
+  private:
+	/*
+	 * Jobs taken at once, the kernels of a stage end with its 'event'
+	 */
+	struct Stage {
+		std::vector<Job> job_vec; //!< Jobs of the stage, using the slots from 'base'
+		int base;
+		cl_event event; //!< Marker after the kernels, nullptr when they finished already
+		cl_mem desc_mem; //!< Descriptor of the batched launch, see LocalSkeleton
+		std::vector<int> desc; //!< Host side of 'desc_mem', kept till the launch completes
+	};
+
+	void allocStages();
+	void freeStages();
+	void compute(Stage &stage);
+	void retire();
+	void finish(Stage &stage);
 
   private:
 	Cache &cache; // Aggregate
@@ -48,10 +69,17 @@ class Worker
 	Clock &clock; // Aggregate
 	Config &conf; // Aggregate
 
-	InKeyList in_keys;
-	BlockList in_blk;
-	OutKeyList out_keys;
-	BlockList out_blk;
+	std::vector<Stage> stage_list; //!< Ring of stages, 'num_flight' of them in flight from 'head'
+	int head, num_flight;
+
+	std::vector<InKeyList> in_keys; //!< One slot per job of every stage
+	std::vector<BlockList> in_blk;
+	std::vector<OutKeyList> out_keys;
+	std::vector<BlockList> out_blk;
+	std::vector<uint8_t> reused; //!< Slots whose outputs were all reused, their inputs were not loaded
+
+	std::vector<Coord> bat_coord; //!< Jobs computed in one batched launch
+	std::vector<const BlockList*> bat_in, bat_out;
 };
 
 } } // namespace map::detail
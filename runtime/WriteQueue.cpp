@@ -0,0 +1,120 @@
+/**
+ * @file    WriteQueue.cpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "WriteQueue.hpp"
+#include "Clock.hpp"
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+WriteQueue::WriteQueue(Clock &clock, Config &conf)
+	: clock(clock)
+	, conf(conf)
+	, closed(false)
+{ }
+
+void WriteQueue::allocBuffers(cle::Context ctx, size_t unit_mem_size) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	cl_int err;
+
+	closed = false;
+	int num_buf = (conf.num_writers > 0) ? conf.write_buffer / unit_mem_size : 0;
+
+	for (int i=0; i<num_buf; i++) {
+		cl_mem mem = clCreateBuffer(*ctx, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, unit_mem_size, nullptr, &err);
+		cle::clCheckError(err);
+		void *ptr = clEnqueueMapBuffer(*ctx.Q(0), mem, CL_TRUE, MAP_READ | MAP_WRITE, 0, unit_mem_size, 0, nullptr, nullptr, &err);
+		cle::clCheckError(err);
+
+		stage_list.emplace_back(mem,-1); // not managed by the replacement policy
+		stage_list.back().host_mem = ptr;
+		stage_ptr.push_back(ptr);
+		free_list.push_back(&stage_list.back());
+	}
+}
+
+void WriteQueue::freeBuffers(cle::Context ctx) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	cl_int err;
+
+	assert(job_queue.empty() && pending.empty());
+	assert(free_list.size() == stage_list.size());
+
+	for (int i=0; i<stage_list.size(); i++) {
+		err = clEnqueueUnmapMemObject(*ctx.Q(0), stage_list[i].dev_mem, stage_ptr[i], 0, nullptr, nullptr);
+		cle::clCheckError(err);
+		err = clReleaseMemObject(stage_list[i].dev_mem);
+		cle::clCheckError(err);
+	}
+
+	stage_list.clear();
+	stage_ptr.clear();
+	free_list.clear();
+}
+
+bool WriteQueue::enabled() const {
+	return !stage_list.empty();
+}
+
+Entry* WriteQueue::acquire() {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	if (free_list.empty()) { // Back-pressure, waits for the Writers
+		TimedRegion region(clock,BACKPRES);
+		cv_free.wait(lock,[&]{ return !free_list.empty(); });
+	}
+
+	Entry *stage = free_list.back();
+	free_list.pop_back();
+	return stage;
+}
+
+void WriteQueue::push(const WriteJob &job) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	assert(!closed);
+
+	job_queue.push_back(job);
+	pending[job.block.key]++;
+	cv_job.notify_one();
+}
+
+bool WriteQueue::pop(WriteJob &job) {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+
+	cv_job.wait(lock,[&]{ return !job_queue.empty() || closed; });
+	if (job_queue.empty())
+		return false; // Closed and drained, exit point for the Writers
+
+	job = job_queue.front();
+	job_queue.pop_front();
+	return true;
+}
+
+void WriteQueue::done(const WriteJob &job) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+
+	auto it = pending.find(job.block.key);
+	if (--it->second == 0)
+		pending.erase(it);
+	free_list.push_back(job.stage);
+
+	cv_free.notify_one();
+	cv_key.notify_all();
+}
+
+void WriteQueue::close() {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	closed = true;
+	cv_job.notify_all();
+}
+
+void WriteQueue::waitForKey(const Key &key) {
+	std::unique_lock<std::mutex> lock(mtx); // thread-safe
+	cv_key.wait(lock,[&]{ return pending.find(key) == pending.end(); });
+}
+
+} } // namespace map::detail
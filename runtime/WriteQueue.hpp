@@ -0,0 +1,73 @@
+/**
+ * @file    WriteQueue.hpp
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: write-behind queue. Dirty blocks are staged into pinned buffers and written to their files by the Writers
+ * Note: the number of staging buffers bounds the memory of the queue, acquire() blocks when none is left (back-pressure)
+ * Note: a block with a pending write can't be read from its file, see waitForKey()
+ */
+
+#ifndef MAP_RUNTIME_WRITEQUEUE_HPP_
+#define MAP_RUNTIME_WRITEQUEUE_HPP_
+
+#include "Entry.hpp"
+#include "Block.hpp"
+#include "Config.hpp"
+#include "../cle/cle.hpp"
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace map { namespace detail {
+
+class Clock; // Forward declaration
+
+/*
+ * Pending write of a dirty block
+ */
+struct WriteJob {
+	Block block; //!< Copy of the block to be written
+	Entry *stage; //!< Staging buffer with the data, or receiving it
+	Entry *entry; //!< Device entry kept reserved until received, nullptr when the data is already staged
+};
+
+class WriteQueue
+{
+  public:
+	WriteQueue(Clock &clock, Config &conf);
+	WriteQueue(const WriteQueue&) = delete;
+	WriteQueue& operator=(const WriteQueue&) = delete;
+
+	void allocBuffers(cle::Context ctx, size_t unit_mem_size);
+	void freeBuffers(cle::Context ctx);
+	bool enabled() const;
+
+	Entry* acquire();
+	void push(const WriteJob &job);
+	bool pop(WriteJob &job);
+	void done(const WriteJob &job);
+	void close();
+
+	void waitForKey(const Key &key);
+
+  private:
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+
+	std::deque<Entry> stage_list; //!< Staging buffers, pinned host memory
+	std::vector<void*> stage_ptr; //!< Mapped pointers of the staging buffers
+	std::vector<Entry*> free_list; //!< Staging buffers not in use
+	std::deque<WriteJob> job_queue; //!< Jobs waiting for a Writer
+	std::unordered_map<Key,int,key_hash> pending; //!< Keys with writes not finished yet
+	bool closed; //!< No more jobs will be pushed, the Writers exit when the queue empties
+
+	std::mutex mtx;
+	std::condition_variable cv_free, cv_job, cv_key;
+};
+
+} } // namespace map::detail
+
+#endif
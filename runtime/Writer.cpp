@@ -0,0 +1,34 @@
+/**
+ * @file    Writer.cpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "Writer.hpp"
+#include "Cache.hpp"
+#include "Clock.hpp"
+
+
+namespace map { namespace detail {
+
+/**********
+   Writer
+ **********/
+
+Writer::Writer(Cache &cache, Clock &clock, Config &conf)
+	: cache(cache)
+	, clock(clock)
+	, conf(conf)
+{ }
+
+void Writer::work(ThreadId thread_id) {
+	Tid = thread_id; // Local thread id initialization
+
+	while (true) // Writer loop
+	{
+		if (!cache.writeBehind())
+			break; // Exit point
+	}
+}
+
+} } // namespace map::detail
@@ -0,0 +1,44 @@
+/**
+ * @file    Writer.hpp 
+ * @author  Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * NOTE: writers are I/O threads, they take the ranks after the prefetchers (i.e. rank = num_ranks + num_prefetchers + i)
+ * NOTE: writers exit once the write-behind queue is closed and drained, see Cache::drainWrites
+ */
+
+#ifndef MAP_RUNTIME_WRITER_HPP_
+#define MAP_RUNTIME_WRITER_HPP_
+
+#include "ThreadId.hpp"
+#include "Config.hpp"
+
+
+namespace map { namespace detail {
+
+class Cache; // Forward declaration
+class Clock; // Forward declaration
+
+/*
+ * Writes the dirty blocks queued by the workers, behind their back
+ */
+class Writer
+{
+  public:
+	Writer(Cache &cache, Clock &clock, Config &conf);
+	~Writer() = default;
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+	Writer(Writer&&) = default;
+	Writer& operator=(Writer&&) = default;
+
+	void work(ThreadId thread_id);
+
+  private:
+	Cache &cache; // Aggregate
+	Clock &clock; // Aggregate
+	Config &conf; // Aggregate
+};
+
+} } // namespace map::detail
+
+#endif
@@ -28,7 +28,7 @@ std::size_t Write::Hash::operator()(const Key& k) const {
 
 // Factory
 
-Node* Write::Factory(Node *prev, std::string file_path) {
+Node* Write::Factory(Node *prev, std::string file_path, CompressType compress, int level, bool predictor) {
 	assert(prev != nullptr);
 	assert(prev->numdim() != D0);
 
@@ -42,6 +42,11 @@ Node* Write::Factory(Node *prev, std::string file_path) {
 	if (ferr) {
 		assert(0);
 	}
+	// Attempts to set the compression, before opening
+	ferr = out_file->setCompression(compress,level,predictor);
+	if (ferr) {
+		assert(0);
+	}
 	// Attemtps to open the file for writting
 	ferr = out_file->open(file_path, OUT);
 	if (ferr) {
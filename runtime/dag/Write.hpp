@@ -30,7 +30,7 @@ struct Write : public OutputNode
 	};
 	
 	// Factory
-	static Node* Factory(Node *prev, std::string file_path);
+	static Node* Factory(Node *prev, std::string file_path, CompressType compress=NONE_COMPRESS, int level=0, bool predictor=false);
 	static Node* Clone(Write *write, Node *prev); // @
 
 	// Constructors & methods
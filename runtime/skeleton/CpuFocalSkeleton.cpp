@@ -41,7 +41,7 @@ void CpuFocalSkeleton::generate() {
 	compact(); // compact structures
 
 	ver->shared_size = -1;
-	ver->group_size = BlockSize{16,16}; // @
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
 	ver->num_group = (ver->task->blocksize() - 1) / ver->groupsize() + 1;	
 	ver->code = versionCode();
 }
@@ -179,49 +179,55 @@ string CpuFocalSkeleton::versionCode() {
 
 	if (!code[PRECORE].empty())
 	{
-		// Global-if
-		add_line( "if ("+global_cond(N)+") {" );
-		indent_count++;
+		// Interior groups read their halo from the central block alone, see FocalSkeleton.cpp
+		for (bool inner : {true,false})
+		{
+			// Inner-if / global-if
+			if (inner)
+				add_line( "if ("+inner_cond_focal(N)+") {" );
+			else
+				add_line( "} else if ("+global_cond(N)+") {" );
+			indent_count++;
 
-		// Load-loop
-		add_line( "for ("+pre_load_loop(N)+")" );
-		add_line( "{" );
-		indent_count++;
+			// Load-loop
+			add_line( "for ("+pre_load_loop(N)+")" );
+			add_line( "{" );
+			indent_count++;
 
-		// Displaced indexing variables
-		add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
-		add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
-		for (int n=0; n<N; n++) {
-			add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
-		}
-		for (int n=0; n<N; n++) {
-			add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
-		}
-		add_line( "" );
+			// Displaced indexing variables
+			add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
+			add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
+			for (int n=0; n<N; n++) {
+				add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
+			}
+			for (int n=0; n<N; n++) {
+				add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
+			}
+			add_line( "" );
 
-		// Adds PRECORE input-nodes
-		for (auto &node : ver->task->inputList()) {
-			if (tag_hash[node] == PRECORE) {
-				add_line( var_name(node) + " = " + in_var_focal(node) + ";" );
+			// Adds PRECORE input-nodes
+			for (auto &node : ver->task->inputList()) {
+				if (tag_hash[node] == PRECORE) {
+					add_line( var_name(node) + " = " + (inner ? in_var(node) : in_var_focal(node)) + ";" );
+				}
 			}
-		}
 
-		// Adds accumulated 'precore' to 'all'
-		code[ALL_POS] += code[PRECORE];
+			// Adds accumulated 'precore' to 'all'
+			code[ALL_POS] += code[PRECORE];
 
-		// Filling focal shared memory
-		for (auto &node : shared) {
-			string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
-			string var = var_name(node);
-			add_line( svar + " = " + var + ";" );
+			// Filling focal shared memory
+			for (auto &node : shared) {
+				string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
+				string var = var_name(node);
+				add_line( svar + " = " + var + ";" );
+			}
+			
+			// Closes load-loop
+			indent_count--;
+			add_line( "}" );
+			indent_count--;
 		}
-		
-		// Closes load-loop
-		indent_count--;
-		add_line( "}" );
-		// Closes global-if
-		indent_count--;
-		add_line( "}" );
+		add_line( "}" ); // Closes global-if
 		// Synchronizes
 		add_line( "barrier(CLK_LOCAL_MEM_FENCE);" );
 		add_line( "" );
@@ -235,22 +241,22 @@ string CpuFocalSkeleton::versionCode() {
 	add_line( "{" );
 	indent_count++;
 
-	// Inner-part global-if
-	add_line( "if (GC0 > 1 && GC0 < GN0-1 && GC1 > 1 && GC1 < GN1-1)" );
+	// Inner-part if, the group and its halo lie inside the block
+	add_line( "if ("+inner_cond_focal(N)+")" );
 	add_line( "{" );
 	indent_count++;
 
-	// Adds accumulated 'core' to 'all'
+	// Adds accumulated 'core' to 'all', filled with 'inner_part' set
 	code[ALL_POS] += code[CORE];
 
 	indent_count--;
 	add_line( "}" ); // Closes inner part
 
-	// Outer-part global-if
-	add_line( "if (GC0 == 0 || GC0 == GN0-1 || GC1 == 0 || GC1 == GN1-1)" );
+	// Outer-part else, the halo might fall in the neighbor blocks
+	add_line( "else" );
 	add_line( "{" );
 
-	// Adds accumulated 'core' to 'all'
+	// Visits the focal nodes again, now loading through the neighbor blocks
 	inner_part = false;
 	node_pos = ALL_POS;
 	for (auto node : ver->task->nodeList()) {
@@ -382,14 +388,20 @@ void CpuFocalSkeleton::visit(FocalFunc *node) {
 	{
 		const int N = node->numdim().toInt();
 		string var = var_name(node);
-		string type = node->prev()->datatype().ctypeString();
-		string load = "load_F_" + type + "(VAR_LIST(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
+		string type = node->prev()->datatype().toString();
+		string load;
+
+		if (inner_part)
+			load = "load_L_" + type + "(VAR(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
+		else // outer_part
+			load = "load_F_" + type + "(VAR_LIST(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
 
 		add_line( var + " = " + node->type.neutralString(node->datatype()) + ";" );
 
 		for (int n=N-1; n>=0; n--) {
+			int h = node->halo()[n];
 			string i = string("i") + n;
-			add_line( "for (int "+i+"=0; "+i+"<"+(node->halo()[n]*2+1)+"; "+i+"++) {" );
+			add_line( "for (int "+i+"=-"+h+"; "+i+"<="+h+"; "+i+"++) {" );
 			indent_count++;
 		}
 
@@ -420,14 +432,20 @@ void CpuFocalSkeleton::visit(FocalPercent *node) {
 		const int N = node->numdim().toInt();
 		string var = var_name(node);
 		string pvar = var_name(node->prev());
-		string type = node->prev()->datatype().ctypeString();
-		string load = "load_" + type + "(VAR_LIST(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
+		string type = node->prev()->datatype().toString();
+		string load;
+
+		if (inner_part)
+			load = "load_L_" + type + "(VAR(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
+		else // outer_part
+			load = "load_F_" + type + "(VAR_LIST(IN_" + node->prev()->id + "),bc0+i0,bc1+i1,BS0,BS1)";
 
 		add_line( var + " = 0;" );
 
 		for (int n=N-1; n>=0; n--) {
+			int h = node->halo()[n];
 			string i = string("i") + n;
-			add_line( "for (int "+i+"=0; "+i+"<"+(node->halo()[n]*2+1)+"; "+i+"++) {" );
+			add_line( "for (int "+i+"=-"+h+"; "+i+"<="+h+"; "+i+"++) {" );
 			indent_count++;
 		}
 
@@ -0,0 +1,312 @@
+/**
+ * @file	CpuLocalSkeleton.cpp 
+ * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: D0 nodes keep their scalar code, OpenCL widens them when operating with vectors
+ * Note: the vector variables shadow the scalar ones of the same name, declared inside the vector branch
+ */
+
+#include "CpuLocalSkeleton.hpp"
+#include "util.hpp"
+#include "../Version.hpp"
+#include "../task/Task.hpp"
+#include <iostream>
+#include <functional>
+#include <algorithm>
+
+
+namespace map { namespace detail {
+
+namespace { // anonymous namespace
+	using std::string;
+
+	bool isBool(const Node *node) {
+		return node->datatype() == B8;
+	}
+
+	bool isScalarBool(const Node *node) {
+		return node->numdim() == D0 && isBool(node);
+	}
+}
+
+/***************
+   Constructor
+ ***************/
+
+CpuLocalSkeleton::CpuLocalSkeleton(Version *ver)
+	: LocalSkeleton(ver)
+	, vector(false)
+	, scalar_core()
+	, vector_core()
+{
+	// 256 bits per vector, within the 4..16 widths of OpenCL
+	int max_size = 1;
+	for (auto node : full_join(ver->task->inputList(),ver->task->nodeList()))
+		max_size = std::max(max_size,node->datatype().sizeOf());
+	width = std::min(16,std::max(4,32/max_size));
+}
+
+void CpuLocalSkeleton::generate() {
+	// Scalar code of the tail, one level below the vector branch
+	indent_count = 4;
+	fill(); // fill structures
+	compact(); // compact structures
+	scalar_core = code[POSCORE];
+	code[POSCORE].clear();
+
+	// Vector code, walking the same nodes again
+	indent_count = 3;
+	vector = true;
+	for (auto node : ver->task->nodeList()) {
+		node_pos = tag_hash[node];
+		node->accept(this);
+	}
+	vector = false;
+	vector_core = code[POSCORE];
+	code[POSCORE].clear();
+	node_pos = ALL_POS;
+
+	BlockSize work_size = ver->task->blocksize();
+	work_size[0] = (work_size[0] - 1) / width + 1;
+
+	ver->shared_size = -1;
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
+	ver->vec_width = width;
+	ver->num_group = (work_size - 1) / ver->groupsize() + 1;
+	ver->batched = batchable();
+	ver->code = versionCode();
+}
+
+bool CpuLocalSkeleton::vectorizable(const Version *ver) {
+	const Task *task = ver->task;
+
+	// 2D rows, no boolean memory (OpenCL has no bool vectors) and no D0 outputs
+	if (task->numdim() != D2)
+		return false;
+	for (auto node : task->inputList())
+		if (isBool(node))
+			return false;
+	for (auto node : task->outputList())
+		if (isBool(node) || node->numdim() == D0)
+			return false;
+
+	// Nodes whose vector code is the scalar one with vector types, or a builtin taking vectors
+	for (auto node : task->nodeList()) {
+		if (node->numdim() == D0)
+			continue; // Scalar code anyway
+		DataType dt = node->datatype();
+
+		if (dynamic_cast<Constant*>(node) || dynamic_cast<Index*>(node) || dynamic_cast<Barrier*>(node)) {
+			continue;
+		} else if (auto *cast = dynamic_cast<Cast*>(node)) {
+			if (isScalarBool(cast->prev()))
+				return false;
+		} else if (auto *una = dynamic_cast<Unary*>(node)) {
+			DataType pt = una->prev()->datatype();
+			if (isBool(una->prev()) && una->type != NOT)
+				return false; // Arithmetic over -1 / 0
+			if (una->type.isFunction() && !pt.isFloating())
+				return false; // e.g. fabs() has no integer vectors
+			if (dt != pt && dt != B8)
+				return false;
+		} else if (auto *bin = dynamic_cast<Binary*>(node)) {
+			Node *lhs = bin->left(), *rhs = bin->right();
+			bool logic = (bin->type == AND || bin->type == OR || bin->type == EQ || bin->type == NE);
+			if (isScalarBool(lhs) || isScalarBool(rhs))
+				return false;
+			if ((isBool(lhs) || isBool(rhs)) && !logic)
+				return false;
+			if (lhs->datatype() != rhs->datatype())
+				return false; // No implicit conversions among vectors, nor widening of higher ranks
+			DataType pt = (lhs->numdim() != D0) ? lhs->datatype() : rhs->datatype();
+			if (bin->type.isFunction() && !pt.isFloating())
+				return false;
+			if (dt != pt && dt != B8)
+				return false;
+		} else if (auto *cond = dynamic_cast<Conditional*>(node)) {
+			if (cond->cond()->numdim() != D0 && !isBool(cond->cond()))
+				return false; // select() looks at the sign bit
+			if (isScalarBool(cond->left()) || isScalarBool(cond->right()))
+				return false;
+			if (cond->left()->datatype() != dt || cond->right()->datatype() != dt)
+				return false;
+		} else {
+			return false; // Rand, Diversity, Access... stay scalar
+		}
+	}
+	return true;
+}
+
+/***********
+   Methods
+ ***********/
+
+string CpuLocalSkeleton::vtype(DataType dt) const {
+	string type = (dt == B8) ? string("char") : dt.ctypeString();
+	return type + width;
+}
+
+string CpuLocalSkeleton::lanes() const {
+	// (intN)(0,1,2,...,N-1)
+	string str = "(int" + std::to_string(width) + ")(0";
+	for (int i=1; i<width; i++)
+		str += string(",") + i;
+	return str + ")";
+}
+
+void CpuLocalSkeleton::coreCode(int N) {
+	string W = std::to_string(width);
+	string proj = global_proj(N);
+
+	// Global-if
+	add_line( "if ("+global_cond(N)+") {" );
+	indent_count++;
+
+	// Vector branch, 'width' cells at once
+	add_line( "if (bc0+"+W+" <= BS0) {" );
+	indent_count++;
+
+	// Declaring vectors, D0 nodes stay scalar
+	std::vector<std::vector<int>> vec_ids(N_DATATYPE);
+	for (auto node : full_join(ver->task->inputList(),ver->task->nodeList()))
+		if (!node->isOutput() && node->numdim() != D0)
+			vec_ids[node->datatype().get()].push_back(node->id);
+	for (int i=F32; i<N_DATATYPE; i++) {
+		if (vec_ids[i].empty())
+			continue;
+		DataType dt = static_cast<DataTypeEnum>(i);
+		string str = vtype(dt);
+		for (auto id : vec_ids[i])
+			str += " " + dt.toString() + "_" + id + ",";
+		str[str.size()-1] = ';';
+		add_line( str );
+	}
+
+	// Adds POSCORE input-nodes, the fixed ones are broadcast
+	for (auto &node : ver->task->inputList()) {
+		if (tag_hash[node] != POSCORE)
+			continue;
+		if (node->numdim() == D0) {
+			add_line( var_name(node) + " = " + in_var(node) + ";" );
+			continue;
+		}
+		string in = string("IN_") + node->id;
+		add_line( var_name(node) + " = ("+in+"f) ? ("+vtype(node->datatype())+")("+in+"v) : vload"+W+"(0,"+in+"+"+proj+");" );
+	}
+
+	add_section( vector_core );
+
+	// Adds POSCORE output-nodes
+	for (auto &node : ver->task->outputList()) {
+		if (tag_hash[node] == POSCORE) {
+			add_line( "vstore"+W+"("+var_name(node)+",0,OUT_"+node->id+"+"+proj+");" );
+		}
+	}
+
+	indent_count--;
+	add_line( "} else { // Scalar tail of the row" );
+	indent_count++;
+
+	add_line( "for (; bc0<BS0; bc0++) {" );
+	indent_count++;
+
+	// Adds POSCORE input-nodes
+	for (auto &node : ver->task->inputList()) {
+		if (tag_hash[node] == POSCORE) {
+			add_line( var_name(node) + " = " + in_var(node) + ";" );
+		}
+	}
+
+	add_section( scalar_core );
+
+	// Adds POSCORE output-nodes
+	for (auto &node : ver->task->outputList()) {
+		if (tag_hash[node] == POSCORE) {
+			add_line( out_var(node) + " = " + var_name(node) + ";" );
+		}
+	}
+
+	indent_count--;
+	add_line( "}" ); // Closes tail loop
+	indent_count--;
+	add_line( "}" ); // Closes vector-if
+	indent_count--;
+	add_line( "}" ); // Closes global-if
+}
+
+/*********
+   Visit
+ *********/
+
+void CpuLocalSkeleton::visit(Constant *node) {
+	if (!vector || node->numdim() == D0)
+		return Skeleton::visit(node);
+	string cnst = node->cnst.toString();
+	if (isBool(node))
+		cnst = "-(" + cnst + ")"; // true is -1
+	add_line( var_name(node) + " = (" + vtype(node->datatype()) + ")(" + cnst + ");" );
+}
+
+void CpuLocalSkeleton::visit(Index *node) {
+	if (!vector || node->numdim() == D0)
+		return Skeleton::visit(node);
+	string var = var_name(node);
+	string type = node->datatype().ctypeString();
+
+	if (node->dim == D1) // Grows along the row
+		add_line( var + " = convert_" + type + width + "((BC0*BS0+bc0) + " + lanes() + ");" );
+	else if (node->dim == D2) // Equal for the whole row
+		add_line( var + " = (" + vtype(node->datatype()) + ")(BC1*BS1+bc1);" );
+	else
+		assert(0);
+}
+
+void CpuLocalSkeleton::visit(Cast *node) {
+	if (!vector || node->numdim() == D0)
+		return Skeleton::visit(node);
+	string var = var_name(node);
+	string pvar = var_name(node->prev());
+
+	if (node->type == B8)
+		add_line( var + " = convert_char" + width + "(" + pvar + " != 0);" );
+	else if (isBool(node->prev()))
+		add_line( var + " = convert_" + node->type.ctypeString() + width + "(-" + pvar + ");" );
+	else
+		add_line( var + " = convert_" + node->type.ctypeString() + width + "(" + pvar + ");" );
+}
+
+void CpuLocalSkeleton::visit(Unary *node) {
+	if (!vector || node->numdim() == D0 || !isBool(node))
+		return Skeleton::visit(node); // Vector builtins share the name with the scalar ones
+	string var = var_name(node);
+	string pvar = var_name(node->prev());
+	add_line( var + " = convert_char" + width + "(" + node->type.code() + pvar + ");" );
+}
+
+void CpuLocalSkeleton::visit(Binary *node) {
+	if (!vector || node->numdim() == D0 || !isBool(node))
+		return Skeleton::visit(node);
+	string var = var_name(node);
+	string lvar = var_name(node->left());
+	string rvar = var_name(node->right());
+	add_line( var + " = convert_char" + width + "(" + lvar + " "+node->type.code()+" " + rvar + ");" );
+}
+
+void CpuLocalSkeleton::visit(Conditional *node) {
+	if (!vector || node->numdim() == D0 || node->cond()->numdim() == D0)
+		return Skeleton::visit(node); // A scalar condition picks whole vectors
+	string var = var_name(node);
+	string cvar = var_name(node->cond());
+	string lvar = var_name(node->left());
+	string rvar = var_name(node->right());
+
+	// The mask of select() needs the size of the elements, taken from the -1 / 0 booleans
+	DataType dt = node->datatype();
+	int size = (dt == B8) ? 1 : dt.sizeOf();
+	string mask = (size == 1) ? "char" : (size == 2) ? "short" : (size == 4) ? "int" : "long";
+	string vl = (node->left()->numdim() == D0) ? "("+vtype(dt)+")("+lvar+")" : lvar;
+	string vr = (node->right()->numdim() == D0) ? "("+vtype(dt)+")("+rvar+")" : rvar;
+	add_line( var + " = select(" + vr + "," + vl + ",convert_" + mask + width + "(" + cvar + "));" );
+}
+
+} } // namespace map::detail
@@ -0,0 +1,52 @@
+/**
+ * @file	CpuLocalSkeleton.hpp 
+ * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Visitor of the dag that composes the local kernels of CPU devices with explicit vector types
+ *
+ * Note: every work-item computes 'width' contiguous cells of a row, the last cells of the row go through a scalar tail
+ * Note: vector booleans are 'charN' holding -1 / 0, as returned by the relational operators, and the mask of select()
+ * Note: only simple dags are vectorized (see vectorizable), otherwise the Factory gives the scalar LocalSkeleton
+ */
+
+#ifndef MAP_RUNTIME_SKELETON_LOCAL_CPU_HPP_
+#define MAP_RUNTIME_SKELETON_LOCAL_CPU_HPP_
+
+#include "LocalSkeleton.hpp"
+
+
+namespace map { namespace detail {
+
+#define DECLARE_VISIT(class) virtual void visit(class *node);
+
+struct CpuLocalSkeleton : public LocalSkeleton
+{
+  // constructor and main function
+	CpuLocalSkeleton(Version *ver);
+	void generate();
+	static bool vectorizable(const Version *ver);
+
+  // methods
+	void coreCode(int N);
+	std::string vtype(DataType dt) const;
+	std::string lanes() const;
+
+  // visit
+	DECLARE_VISIT(Constant)
+	DECLARE_VISIT(Index)
+	DECLARE_VISIT(Cast)
+	DECLARE_VISIT(Unary)
+	DECLARE_VISIT(Binary)
+	DECLARE_VISIT(Conditional)
+
+  // vars
+	bool vector; //!< Signals visitors to generate vector / scalar code
+	std::string scalar_core; //!< Code of one cell, for the tail of the row
+	std::string vector_core; //!< Code of 'width' contiguous cells
+};
+
+#undef DECLARE_VISIT
+
+} } // namespace map::detail
+
+#endif
@@ -40,7 +40,7 @@ void FocalSkeleton::generate() {
 	compact(); // compact structures
 
 	ver->shared_size = -1;
-	ver->group_size = BlockSize{16,16}; // @
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
 	ver->num_group = (ver->task->blocksize() - 1) / ver->groupsize() + 1;
 	ver->code = versionCode();
 }
@@ -86,7 +86,7 @@ string FocalSkeleton::versionCode() {
 			added_F[dt.get()] = true;
 			add_line( "" );
 		}
-		if (!added_L[dt.get()] && isInputOf(node,ver->task->group()).is(LOCAL)) {
+		if (!added_L[dt.get()] && (isInputOf(node,ver->task->group()).is(LOCAL) || isInputOf(node,ver->task->group()).is(FOCAL))) {
 			add_section( defines_local_type(dt) );
 			added_L[dt.get()] = true;
 			add_line( "" );
@@ -157,7 +157,7 @@ string FocalSkeleton::versionCode() {
 		add_line( std::string("int H")+n + " = " + halo_sum(n,halo) + ";" );
 	}
 	for (int n=0; n<N; n++) {
-		add_line( string("int GS")+n+" = 16; // @" );
+		add_line( string("int GS")+n+" = "+std::to_string(ver->groupsize()[n])+";" );
 	}
 
 	add_line( "" );
@@ -172,49 +172,56 @@ string FocalSkeleton::versionCode() {
 	//// Previous to core ////
 	add_line( "// Previous to FOCAL core\n" );
 
-	// Global-if
-	add_line( "if ("+global_cond(N)+") {" );
-	indent_count++;
+	// Interior groups read their halo from the central block alone, without bounds checks
+	// Border groups go through LOAD_F, which picks the neighbor block or the HOLD_0 mirror
+	for (bool inner : {true,false})
+	{
+		// Inner-if / global-if
+		if (inner)
+			add_line( "if ("+inner_cond_focal(N)+") {" );
+		else
+			add_line( "} else if ("+global_cond(N)+") {" );
+		indent_count++;
 
-	// Load-loop
-	add_line( "for ("+pre_load_loop(N)+")" );
-	add_line( "{" );
-	indent_count++;
+		// Load-loop
+		add_line( "for ("+pre_load_loop(N)+")" );
+		add_line( "{" );
+		indent_count++;
 
-	// Displaced indexing variables
-	add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
-	add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
-	for (int n=0; n<N; n++) {
-		add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
-	}
-	for (int n=0; n<N; n++) {
-		add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
-	}
-	add_line( "" );
+		// Displaced indexing variables
+		add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
+		add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
+		for (int n=0; n<N; n++) {
+			add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
+		}
+		for (int n=0; n<N; n++) {
+			add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
+		}
+		add_line( "" );
 
-	// Adds PRECORE input-nodes
-	for (auto &node : ver->task->inputList()) {
-		if (tag_hash[node] == PRECORE) {
-			add_line( var_name(node) + " = " + in_var_focal(node) + ";" );
+		// Adds PRECORE input-nodes
+		for (auto &node : ver->task->inputList()) {
+			if (tag_hash[node] == PRECORE) {
+				add_line( var_name(node) + " = " + (inner ? in_var(node) : in_var_focal(node)) + ";" );
+			}
 		}
-	}
 
-	// Adds accumulated 'precore' to 'all'
-	code[ALL_POS] += code[PRECORE];
+		// Adds accumulated 'precore' to 'all'
+		code[ALL_POS] += code[PRECORE];
 
-	// Filling focal shared memory
-	for (auto &node : shared) {
-		string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
-		string var = var_name(node);
-		add_line( svar + " = " + var + ";" );
+		// Filling focal shared memory
+		for (auto &node : shared) {
+			string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
+			string var = var_name(node);
+			add_line( svar + " = " + var + ";" );
+		}
+		
+		// Closes load-loop
+		indent_count--;
+		add_line( "}" );
+		indent_count--;
 	}
-	
-	// Closes load-loop
-	indent_count--;
-	add_line( "}" );
-	// Closes global-if
-	indent_count--;
-	add_line( "}" );
+	add_line( "}" ); // Closes global-if
 	// Synchronizes
 	add_line( "barrier(CLK_LOCAL_MEM_FENCE);" );
 	add_line( "" );
@@ -7,7 +7,7 @@
  * TODO: the halos should be computed first, then the center. This way the scalar variables
  *       keep the right values and they can be reused in the POSCORE section
  *       Now inputs are read in POSCORE just in case, even when not needed
- * TODO: try filtering the access to halos by Group position first (sort of like CpuFocal)
+ * Note: groups whose halo lies inside the block load it without bounds checks, see inner_cond_focal()
  */
 
 #ifndef MAP_RUNTIME_SKELETON_FOCAL_HPP_
@@ -2,6 +2,8 @@
  * @file	LocalSkeleton.cpp 
  * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
  *
+ * Note: the batched kernel '_B' computes one block per get_global_id(2), the entries are addressed by their
+ *       byte offset into one cache chunk, given in the descriptor 'DESC' together with the block coordinates
  */
 
 #include "LocalSkeleton.hpp"
@@ -24,6 +26,7 @@ namespace { // anonymous namespace
 
 LocalSkeleton::LocalSkeleton(Version *ver)
 	: Skeleton(ver)
+	, width(1)
 {
 	indent_count = 2;
 }
@@ -33,8 +36,9 @@ void LocalSkeleton::generate() {
 	compact(); // compact structures
 
 	ver->shared_size = -1;
-	ver->group_size = BlockSize{16,16};
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
 	ver->num_group = (ver->task->blocksize() - 1) / ver->groupsize() + 1;	
+	ver->batched = batchable();
 	ver->code = versionCode();
 }
 
@@ -42,10 +46,19 @@ void LocalSkeleton::generate() {
    Methods
  ***********/
 
+bool LocalSkeleton::batchable() {
+	// Only 2D blocks on CPU devices, whose entries share the host memory (zero-copy), and no D0 outputs
+	if (ver->task->numdim() != D2 || ver->deviceType() != DEV_CPU)
+		return false;
+	for (auto &node : ver->task->outputList())
+		if (node->numdim() == D0)
+			return false;
+	return true;
+}
+
 string LocalSkeleton::versionCode() {
 	//// Variables ////
 	const int N = ver->task->numdim().toInt();
-	string cond, comma;
 
 	//// Header ////
 	indent_count = 0;
@@ -78,22 +91,55 @@ string LocalSkeleton::versionCode() {
 		}
 	}
 
+	// Kernels
+	kernelCode(false);
+	if (ver->batched) {
+		add_line( "" );
+		kernelCode(true);
+	}
+
+	//// Printing ////
+	std::cout << "***\n" << code[ALL_POS] << "***" << std::endl;
+
+	return code[ALL_POS];
+}
+
+void LocalSkeleton::kernelCode(bool batch) {
+	//// Variables ////
+	const int N = ver->task->numdim().toInt();
+	string comma;
+	int desc_size = N; // Block coordinates, then one offset per input / output entry
+
+	indent_count = 0;
+
 	// Signature
-	add_line( kernel_sign(ver->signature()) );
+	add_line( kernel_sign(ver->signature()) + (batch ? "_B" : "") );
 
 	// Arguments
 	add_line( "(" );
 	indent_count++;
+	if (batch) {
+		add_line( "global uchar *CHUNK," );
+		add_line( "global const int *DESC," );
+	}
 	for (auto &node : ver->task->inputList()) {
-		add_line( in_arg(node) );
+		if (!batch)
+			add_line( in_arg(node) );
+		else if (node->numdim() == D0)
+			add_line( in_arg(node) ); // Scalars are common to the whole batch
+		else
+			desc_size++;
 	}
 	for (auto &node : ver->task->outputList()) {
-		add_line( out_arg(node) );
+		if (!batch)
+			add_line( out_arg(node) );
+		else
+			desc_size++;
 	}
 	for (int n=0; n<N; n++) {
 		add_line( string("const int BS") + n + "," );
 	}
-	for (int n=0; n<N; n++) {
+	for (int n=0; n<N && !batch; n++) {
 		add_line( string("const int BC") + n + "," );
 	}
 	for (int n=0; n<N; n++) {
@@ -108,6 +154,30 @@ string LocalSkeleton::versionCode() {
 	//// Declarations ////
 	indent_count++;
 
+	// Unpacking the descriptor of this block of the batch
+	if (batch) {
+		int d = 0;
+		add_line( string("global const int *BD = DESC + get_global_id(2)*") + desc_size + ";" );
+		for (int n=0; n<N; n++) {
+			add_line( string("const int BC") + n + " = BD[" + d++ + "];" );
+		}
+		for (auto &node : ver->task->inputList()) {
+			if (node->numdim() == D0)
+				continue;
+			string type = node->datatype().ctypeString();
+			string name = string("IN_") + node->id;
+			add_line( "global " + type + " *" + name + " = (global " + type + "*)(CHUNK + BD[" + d++ + "]);" );
+			add_line( "const " + type + " " + name + "v = 0;" );
+			add_line( "const uchar " + name + "f = 0;" );
+		}
+		for (auto &node : ver->task->outputList()) {
+			string type = node->datatype().ctypeString();
+			string name = string("OUT_") + node->id;
+			add_line( "global " + type + " *" + name + " = (global " + type + "*)(CHUNK + BD[" + d++ + "]);" );
+		}
+		add_line( "" );
+	}
+
 	// Declaring scalars
 	for (int i=F32; i<N_DATATYPE; i++) {
 		if (!scalar[i].empty()) {
@@ -122,7 +192,8 @@ string LocalSkeleton::versionCode() {
 		add_line( string("int gc")+n+" = get_local_id("+n+");" );
 	}
 	for (int n=0; n<N; n++) {
-		add_line( string("int bc")+n+" = get_global_id("+n+");" );
+		string cells = (n == 0 && width > 1) ? string("*") + width : string("");
+		add_line( string("int bc")+n+" = get_global_id("+n+")"+cells+";" );
 	}
 
 	add_line( "" );
@@ -148,6 +219,13 @@ string LocalSkeleton::versionCode() {
 
 	//// Posterior to core ////
 
+	coreCode(N);
+
+	indent_count--;
+	add_line( "}" ); // Closes kernel body
+}
+
+void LocalSkeleton::coreCode(int N) {
 	// Global-if
 	add_line( "if ("+global_cond(N)+") {" );
 	indent_count++;
@@ -171,13 +249,6 @@ string LocalSkeleton::versionCode() {
 
 	indent_count--;
 	add_line( "}" ); // Closes global-if
-	indent_count--;
-	add_line( "}" ); // Closes kernel body
-
-	//// Printing ////
-	std::cout << "***\n" << code[ALL_POS] << "***" << std::endl;
-
-	return code[ALL_POS];
 }
 
 /*********
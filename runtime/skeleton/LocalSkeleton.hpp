@@ -22,11 +22,15 @@ struct LocalSkeleton : public Skeleton
 	void generate();
 
   // methods
+	bool batchable();
 	std::string versionCode();
+	void kernelCode(bool batch);
+	virtual void coreCode(int N);
 
   // visit
 
   // vars
+	int width; //!< Cells per work-item along the 1st dimension, see CpuLocalSkeleton
 };
 
 #undef DECLARE_VISIT
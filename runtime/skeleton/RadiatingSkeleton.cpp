@@ -43,6 +43,10 @@ void RadiatingSkeleton::generate() {
 	ver->code = versionCode(rcase,fst,snd);
 }
 
+bool RadiatingSkeleton::tunable() const {
+	return false; // One group scans the whole block
+}
+
 /***********
    Methods
  ***********/
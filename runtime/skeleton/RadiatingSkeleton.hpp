@@ -25,6 +25,7 @@ struct RadiatingSkeleton : public Skeleton
   // constructor and main function
 	RadiatingSkeleton(Version *ver);
 	void generate();
+	bool tunable() const;
 
   // methods
 	std::string versionCode(RadialCase rcase, Direction fst, Direction snd);
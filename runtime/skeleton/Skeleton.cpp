@@ -7,6 +7,7 @@
 
 #include "Skeleton.hpp"
 #include "LocalSkeleton.hpp"
+#include "CpuLocalSkeleton.hpp"
 #include "FocalSkeleton.hpp"
 #include "CpuFocalSkeleton.hpp"
 #include "ZonalSkeleton.hpp"
@@ -15,6 +16,7 @@
 #include "SpreadingSkeleton.hpp"
 #include "util.hpp"
 #include "../Version.hpp"
+#include "../Runtime.hpp"
 #include "../task/Task.hpp"
 #include <iostream>
 #include <functional>
@@ -76,7 +78,14 @@ Skeleton* Skeleton::Factory(Version *ver) {
 	}
 	else if ( pat.is(LOCAL) )
 	{
-		return new LocalSkeleton(ver);
+		/**/ if ( ver->deviceType() == DEV_CPU && Runtime::getConfig().cpu_vector && CpuLocalSkeleton::vectorizable(ver) )
+		{
+			return new CpuLocalSkeleton(ver);
+		}
+		else
+		{
+			return new LocalSkeleton(ver);
+		}
 	}
 	else {
 		assert(0);
@@ -98,6 +107,15 @@ Skeleton::Skeleton(Version *ver)
    Methods
  ***********/
 
+bool Skeleton::tunable() const {
+	return true; // The group size is free, the code follows groupSize()
+}
+
+BlockSize Skeleton::groupSize(BlockSize def) const {
+	// Group size found by the Tuning, or the one of a candidate being benchmarked
+	return ver->tune_size.isNone() ? def : ver->tune_size;
+}
+
 void Skeleton::tag(Node *node) {
 	bool is_input = is_included(node,ver->task->inputList());
 	bool visited = wasVisited(node);
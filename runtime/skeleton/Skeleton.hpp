@@ -31,6 +31,7 @@ struct Skeleton : public Visitor
 	Skeleton(Version *ver);
 	virtual ~Skeleton() { };
 	virtual void generate() = 0;
+	virtual bool tunable() const;
 
   // methods
 	void tag(Node *node);
@@ -40,6 +41,7 @@ struct Skeleton : public Visitor
 	std::string indent();
 	void add_line(std::string line);
 	void add_section(std::string section);
+	BlockSize groupSize(BlockSize def) const;
 
   // visit
 	DECLARE_VISIT(Constant)
@@ -30,7 +30,7 @@ void SpreadingSkeleton::generate() {
 	compact(); // compact structures
 
 	ver->shared_size = -1;
-	ver->group_size = BlockSize{16,16}; // @
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
 	ver->num_group = (ver->task->blocksize() - 1) / ver->groupsize() + 1;	
 	ver->code = versionCode();
 
@@ -138,60 +138,69 @@ std::string SpreadingSkeleton::versionCode() {
 	//// Previous to core ////
 	add_line( "// Previous to Spread core\n" );
 
-	// Global-if
-	add_line( "if ("+global_cond(N)+") {" );
-	indent_count++;
-
-	// Load-loop
-	add_line( "for ("+pre_load_loop(N)+")" );
-	add_line( "{" );
-	indent_count++;
+	// Interior groups read their halo from the central block alone, see FocalSkeleton.cpp
+	for (bool inner : {true,false})
+	{
+		// Inner-if / global-if
+		if (inner)
+			add_line( "if ("+inner_cond_focal(N)+") {" );
+		else
+			add_line( "} else if ("+global_cond(N)+") {" );
+		indent_count++;
 
-	// Displaced indexing variables
-	add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
-	add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
-	for (int n=0; n<N; n++) {
-		add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
-	}
-	for (int n=0; n<N; n++) {
-		add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
-	}
-	add_line( "" );
+		// Load-loop
+		add_line( "for ("+pre_load_loop(N)+")" );
+		add_line( "{" );
+		indent_count++;
 
-	// Adds PRECORE input-nodes
-	for (auto &node : ver->task->inputList()) {
-		if (tag_hash[node] == PRECORE) {
-			add_line( var_name(node) + " = " + in_var_focal(node) + ";" );
+		// Displaced indexing variables
+		add_line( "int proj = "+local_proj(N)+" + i*("+group_size_prod(N)+");" );
+		add_line( "if (proj >= "+group_size_prod_H(N)+") continue;" );
+		for (int n=0; n<N; n++) {
+			add_line( string("int gc")+n+" = proj % ("+group_size_prod_H(n+1)+") / "+group_size_prod_H(n)+";" );
 		}
-	}
-	//add_line( var_name(spread[0]) + " = " + in_var_spread(spread[0]) + ";" );
-	//add_line( var_name(spread[0]->spread()) + " = " + in_var_spread(spread[0]->spread()) + ";" );
-
-	// Adds accumulated 'precore' to 'all'
-	code[ALL_POS] += code[PRECORE];
+		for (int n=0; n<N; n++) {
+			add_line( string("int bc")+n+" = get_group_id("+n+")*GS"+n+" + gc"+n+" - H"+n+";" );
+		}
+		add_line( "" );
 
-	// Filling spread shared memory
-	for (auto &node : shared) {
-		if (node == spread[0]->stable())
-		{
-			string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
-			string var = ReductionType(rOR).neutralString(U16);
-			add_line( svar + " = " + var + ";" );	
+		// Adds PRECORE input-nodes
+		for (auto &node : ver->task->inputList()) {
+			if (tag_hash[node] == PRECORE) {
+				if (inner)
+					add_line( var_name(node) + " = IN_" + node->id + "_11[" + global_proj(N) + "];" );
+				else
+					add_line( var_name(node) + " = " + in_var_focal(node) + ";" );
+			}
 		}
-		else
-		{
-			string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
-			string var = var_name(node);
-			add_line( svar + " = " + var + ";" );
+		//add_line( var_name(spread[0]) + " = " + in_var_spread(spread[0]) + ";" );
+		//add_line( var_name(spread[0]->spread()) + " = " + in_var_spread(spread[0]->spread()) + ";" );
+
+		// Adds accumulated 'precore' to 'all'
+		code[ALL_POS] += code[PRECORE];
+
+		// Filling spread shared memory
+		for (auto &node : shared) {
+			if (node == spread[0]->stable())
+			{
+				string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
+				string var = ReductionType(rOR).neutralString(U16);
+				add_line( svar + " = " + var + ";" );	
+			}
+			else
+			{
+				string svar = var_name(node,SHARED) + "[" + local_proj_focal(N) + "]";
+				string var = var_name(node);
+				add_line( svar + " = " + var + ";" );
+			}
 		}
+		
+		// Closes load-loop
+		indent_count--;
+		add_line( "}" );
+		indent_count--;
 	}
-	
-	// Closes load-loop
-	indent_count--;
-	add_line( "}" );
-	// Closes global-if
-	indent_count--;
-	add_line( "}" );
+	add_line( "}" ); // Closes global-if
 	// Synchronizes
 	add_line( "barrier(CLK_LOCAL_MEM_FENCE);" );
 	add_line( "" );
@@ -35,7 +35,7 @@ void ZonalSkeleton::generate() {
 	compact(); // compact structures
 
 	ver->shared_size = -1;
-	ver->group_size = BlockSize{16,16}; // @
+	ver->group_size = groupSize(BlockSize{16,16}); // Unless tuned, see Tuning.hpp
 	ver->num_group = (ver->task->blocksize() - 1) / ver->groupsize() + 1;
 	ver->code = versionCode();
 
@@ -147,7 +147,7 @@ string ZonalSkeleton::versionCode() {
 		add_line( string("int bc")+n+" = get_global_id("+n+");" );
 	}
 	for (int n=0; n<N; n++) {
-		add_line( string("int GS")+n+" = 16; // @" );
+		add_line( string("int GS")+n+" = "+std::to_string(ver->groupsize()[n])+";" );
 	}
 
 	add_line( "" );
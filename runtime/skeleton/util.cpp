@@ -372,6 +372,16 @@ string local_cond_focal(int N) {
 	return str;
 }
 
+string inner_cond_focal(int N) {
+	// Group plus halo inside the block: get_group_id(0)*GS0 >= H0 && (get_group_id(0)+1)*GS0+H0 <= BS0 && ...
+	string str = "";
+	for (int n=0; n<N; n++) {
+		if (n > 0) str += " && ";
+		str += string("get_group_id(")+n+")*GS"+n+" >= H"+n+" && (get_group_id("+n+")+1)*GS"+n+"+H"+n+" <= BS"+n;
+	}
+	return str;
+}
+
 string local_cond_zonal(int N) {
 	// gc0 == 0 && gc1 == 0 && gc2 == 0 ...
 	string str = "";
@@ -100,6 +100,7 @@ std::string group_proj(int N);
 std::string global_cond(int N);
 std::string global_cond_focal(int N);
 std::string local_cond_focal(int N);
+std::string inner_cond_focal(int N);
 std::string global_cond_zonal(int N);
 std::string local_cond_zonal(int N);
 std::string global_cond_radial(int N);
@@ -31,6 +31,7 @@ struct LocalTask : public Task
 	int nextIntraDepends(Node *node, Coord coord) const;
 
 	void compute(Coord coord, const BlockList &in_blk, const BlockList &out_blk);
+	bool pipelined() const { return true; }
 	
 	Pattern pattern() const { return LOCAL; }
 };
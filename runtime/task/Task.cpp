@@ -18,6 +18,9 @@
 #include "../ThreadId.hpp"
 #include "../Runtime.hpp"
 #include <memory>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <cassert>
 
 
@@ -31,6 +34,37 @@ std::size_t task_hash::operator()(const Task *t) const {
 	return std::hash<const Task*>()(t);
 }
 
+namespace { // anonymous namespace
+	struct Launch {
+		Task *task;
+		const Version *ver;
+		int jobs;
+		double host_sec; //!< Host side of the launch: arguments, descriptor and enqueue
+	};
+
+	double now_sec() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void CL_CALLBACK launchDone(cl_event evt, cl_int status, void *data) {
+		// Runs in an OpenCL thread once the kernel completes, the queues are created with profiling
+		std::unique_ptr<Launch> launch((Launch*)data);
+		cl_ulong queued = 0, submit = 0, beg = 0, end = 0;
+		clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, nullptr);
+		clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &submit, nullptr);
+		clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &beg, nullptr);
+		clGetEventProfilingInfo(evt, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, nullptr);
+		clReleaseEvent(evt);
+		if (status != CL_COMPLETE || end < beg || submit < queued)
+			return; // Not measured
+		// Host launch + driver submission + execution. The wait behind the kernels still in flight is not this launch's cost
+		double sec = launch->host_sec + (submit - queued) / 1e9 + (end - beg) / 1e9;
+		launch->ver->addTime(sec,launch->jobs);
+		if (launch->ver->batched)
+			launch->task->tuneBatch(launch->jobs,sec);
+	}
+}
+
 /********
    Task
  ********/
@@ -92,6 +126,11 @@ Task::Task(Group *group)
 	, prev_jobs_count(0)
 	, self_jobs_count(0)
 	, last()
+	, prio(group->id)
+	, batch_size(2) // Measures the batched launches once, then tunes
+	, pending_vers(0)
+	, one_sec(0)
+	, job_sec(0)
 	, mtx()
 {
 	// Links 'group' <-> 'task'
@@ -139,6 +178,10 @@ int Task::id() const {
 	return group()->id;
 }
 
+int Task::priority() const {
+	return prio;
+}
+
 const Group* Task::group() const {
 	return base_group;
 }
@@ -314,12 +357,18 @@ void Task::postStore(Coord coord) {
 		last = Tid;
 }
 
+bool Task::pipelined() const {
+	return false; // Waits for the kernel, e.g. to read the scalar outputs in postCompute()
+}
+
 void Task::compute(Coord coord, const BlockList &in_blk, const BlockList &out_blk) {
 	const Version *ver = version(DEV_ALL,""); // Any device, No detail
 	computeVersion(coord,in_blk,out_blk,ver);
 }
 
 void Task::computeVersion(Coord coord, const BlockList &in_blk, const BlockList &out_blk, const Version *ver) {
+	ver = ver->variant(); // Maybe a candidate group size, see Tuning.hpp
+
 	// CL related vars
 	cle::Task tsk = ver->tsk;
 	cle::Kernel krn = tsk.K(Tid.rnk());
@@ -332,8 +381,10 @@ void Task::computeVersion(Coord coord, const BlockList &in_blk, const BlockList
 	const int dim = numdim().toInt();
 	auto group_size = ver->groupsize();
 	auto block_size = blocksize();
+	auto work_size = block_size;
+	work_size[0] = (block_size[0] - 1) / ver->vec_width + 1; // Vector kernels compute several cells per work-item
 
-	auto nsb = ((block_size-1)/group_size+1)*group_size;
+	auto nsb = ((work_size-1)/group_size+1)*group_size;
 	size_t gws[dim] = {(size_t)nsb[0],(size_t)nsb[1]};
 	size_t lws[dim] = {(size_t)group_size[0],(size_t)group_size[1]};
 
@@ -380,12 +431,155 @@ void Task::computeVersion(Coord coord, const BlockList &in_blk, const BlockList
 	//// Launches kernel
 
 	Runtime::getClock().start(KERNEL);
+	double start = now_sec();
+	cl_event evt = nullptr;
+
+	err = clEnqueueNDRangeKernel(*que, *krn, dim, NULL, gws, lws, 0, nullptr, pipelined() ? &evt : nullptr);
+	cle::clCheckError(err);
+	endLaunch(que,evt,ver,1,start);
+
+	Runtime::getClock().stop(KERNEL);
+}
+
+void Task::endLaunch(cle::Queue que, cl_event evt, const Version *ver, int jobs, double start_sec) {
+	cl_int err;
+
+	if (evt != nullptr) { // Pipelined, the kernel time arrives with its completion
+		double host_sec = now_sec() - start_sec;
+		err = clSetEventCallback(evt, CL_COMPLETE, launchDone, new Launch{this,ver,jobs,host_sec});
+		cle::clCheckError(err);
+		err = clFlush(*que);
+		cle::clCheckError(err);
+		return;
+	}
 
-	err = clEnqueueNDRangeKernel(*que, *krn, dim, NULL, gws, lws, 0, nullptr, nullptr);
 	err = clFinish(*que);
 	cle::clCheckError(err);
 
+	double sec = now_sec() - start_sec;
+	ver->addTime(sec,jobs);
+	if (ver->batched)
+		tuneBatch(jobs,sec);
+}
+
+bool Task::batchable(const BlockList &in_blk, const BlockList &out_blk, cl_mem &chunk) const {
+	const Version *ver = version(DEV_ALL,""); // Same version than compute()
+	if (!ver->batched)
+		return false;
+
+	// Every entry must share the host memory and lie in the same chunk, fixed inputs are not batched
+	chunk = nullptr;
+	auto same_chunk = [&](const Block *b) {
+		if (b->holdtype() != HOLD_N || b->fixed || b->entry == nullptr || !b->entry->unified)
+			return false;
+		if (chunk == nullptr)
+			chunk = b->entry->chunk;
+		return b->entry->chunk == chunk;
+	};
+	for (auto &b : in_blk)
+		if (b->numdim() != D0 && !same_chunk(b))
+			return false;
+	for (auto &b : out_blk)
+		if (!same_chunk(b))
+			return false;
+	return chunk != nullptr;
+}
+
+void Task::computeBatch(const std::vector<Coord> &coord_vec, const std::vector<const BlockList*> &in_vec,
+                        const std::vector<const BlockList*> &out_vec, cl_mem desc_mem, std::vector<int> &desc)
+{
+	const Version *ver = version(DEV_ALL,"")->variant();
+	const Config &conf = Runtime::getConfig();
+	cle::Task tsk = ver->tsk;
+	cle::Kernel krn = tsk.K(conf.num_ranks + Tid.rnk()); // Batched kernels follow the normal ones
+	cle::Queue que = tsk.C().D(Tid.dev()).Q(Tid.rnk());
+	const int num = coord_vec.size();
+	cl_int err;
+
+	assert(num > 1 && ver->batched);
+
+	//// Fills the descriptor, one per block: coordinates, then the offsets of the input / output entries
+	// Note: 'desc' belongs to the caller and lives until the launch completes, the write is not blocking
+
+	desc.clear();
+	cl_mem chunk = nullptr;
+	for (int k=0; k<num; k++) {
+		desc.push_back(coord_vec[k][0]);
+		desc.push_back(coord_vec[k][1]);
+		for (auto &b : *in_vec[k])
+			if (b->numdim() != D0)
+				desc.push_back((int)b->entry->offset);
+		for (auto &b : *out_vec[k])
+			desc.push_back((int)b->entry->offset);
+		chunk = out_vec[k]->front()->entry->chunk;
+	}
+	assert(num <= conf.max_batch_size); // 'desc_mem' is sized for that, see Worker::work
+
+	//// Configures kernel
+
+	auto group_size = ver->groupsize();
+	auto block_size = blocksize();
+	auto work_size = block_size;
+	work_size[0] = (block_size[0] - 1) / ver->vec_width + 1; // Vector kernels compute several cells per work-item
+
+	auto nsb = ((work_size-1)/group_size+1)*group_size;
+	size_t gws[3] = {(size_t)nsb[0],(size_t)nsb[1],(size_t)num};
+	size_t lws[3] = {(size_t)group_size[0],(size_t)group_size[1],1};
+
+	//// Sets kernel arguments
+
+	int arg = 0;
+
+	clSetKernelArg(*krn, arg++, sizeof(cl_mem), &chunk);
+	clSetKernelArg(*krn, arg++, sizeof(cl_mem), &desc_mem);
+	for (auto &b : *in_vec[0]) // The scalars are common to the whole batch
+		if (b->numdim() == D0)
+			clSetKernelArg(*krn, arg++, b->datatype().sizeOf(), &b->value.get());
+	for (int i=0; i<2; i++)
+		clSetKernelArg(*krn, arg++, sizeof(int), &block_size[i]);
+	for (int i=0; i<2; i++)
+		clSetKernelArg(*krn, arg++, sizeof(int), &group_size[i]);
+
+	//// Launches kernel
+
+	Runtime::getClock().start(KERNEL);
+	double start = now_sec();
+	cl_event evt = nullptr;
+
+	err = clEnqueueWriteBuffer(*que, desc_mem, CL_FALSE, 0, desc.size()*sizeof(int), desc.data(), 0, nullptr, nullptr);
+	cle::clCheckError(err);
+	err = clEnqueueNDRangeKernel(*que, *krn, 3, NULL, gws, lws, 0, nullptr, pipelined() ? &evt : nullptr);
+	cle::clCheckError(err); // An in-order queue, the kernel follows the write
+	endLaunch(que,evt,ver,num,start);
+
 	Runtime::getClock().stop(KERNEL);
 }
 
+int Task::batchSize() const {
+	return batch_size;
+}
+
+void Task::tuneBatch(int jobs, double sec) {
+	std::lock_guard<std::mutex> lock(mtx); // thread-safe
+	const Config &conf = Runtime::getConfig();
+	const double alpha = 0.1; // @ weight of the last launch
+
+	// Model: launch = overhead + jobs * per_job. Single launches give 'one_sec', batched ones the 'job_sec' slope
+	if (jobs == 1) {
+		one_sec = (one_sec == 0) ? sec : (1-alpha)*one_sec + alpha*sec;
+		return;
+	}
+	if (one_sec == 0)
+		return; // No single launch measured yet
+	double slope = std::max(0.0,(sec - one_sec) / (jobs - 1));
+	job_sec = (job_sec == 0) ? slope : (1-alpha)*job_sec + alpha*slope;
+
+	// The batch grows until the overhead is below 10% of the launch
+	double overhead = one_sec - job_sec;
+	int size = conf.batch_size;
+	if (job_sec > 0)
+		size = (overhead > 0) ? std::ceil(overhead / (0.1 * job_sec)) : 2;
+	batch_size = std::min(conf.batch_size,std::max(2,size)); // @ never 1, keeps sampling the batched launches
+}
+
 } } // namespace map::detail
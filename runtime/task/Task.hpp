@@ -4,6 +4,10 @@
  *
  * Task base class
  *
+ * Note: pipelined tasks do not wait for their kernels, the worker does it before storing their outputs
+ * Note: tasks with a batched version compute several jobs per launch, 'batch_size' follows the launch overhead
+ * Note: jobs of a task are only issued once 'pending_vers' reaches 0, see Program::compile
+ *
  * TODO: GPU shared memory should be dynamically allocated
  */
 
@@ -21,6 +25,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 
 
 namespace map { namespace detail {
@@ -54,6 +59,7 @@ struct Task
 	
   // methods
 	int id() const;
+	int priority() const;
 	
 	const Group* group() const;
 	const NodeList& nodeList() const;
@@ -97,6 +103,15 @@ struct Task
 
 	virtual void compute(Coord coord, const BlockList &in_blk, const BlockList &out_blk);
 	virtual void computeVersion(Coord coord, const BlockList &in_blk, const BlockList &out_blk, const Version *ver);
+
+	virtual bool pipelined() const;
+	void endLaunch(cle::Queue que, cl_event evt, const Version *ver, int jobs, double start_sec);
+
+	bool batchable(const BlockList &in_blk, const BlockList &out_blk, cl_mem &chunk) const;
+	void computeBatch(const std::vector<Coord> &coord_vec, const std::vector<const BlockList*> &in_vec,
+	                  const std::vector<const BlockList*> &out_vec, cl_mem desc_mem, std::vector<int> &desc);
+	int batchSize() const;
+	void tuneBatch(int jobs, double sec);
 	
 	virtual Pattern pattern() const = 0;
 
@@ -111,6 +126,10 @@ struct Task
 	std::unordered_map<Coord,int,coord_hash,coord_equal> dep_hash; // Structure holding the job dependencies met so far
 	int prev_jobs_count, self_jobs_count;//, next_jobs_count;
 	ThreadId last;
+	int prio; //!< Position by upward rank (see Program::rank), the id when not ranked
+	std::atomic<int> batch_size; //!< Jobs per kernel launch, see tuneBatch
+	std::atomic<int> pending_vers; //!< Versions still being compiled, the Scheduler holds the jobs until 0
+	double one_sec, job_sec; //!< Mean time of a single launch / of each extra job in a batched launch
 
 	mutable std::mutex mtx;
 
@@ -0,0 +1,44 @@
+/**
+ * @file	CompressType.cpp 
+ * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ */
+
+#include "CompressType.hpp"
+#include <cassert>
+
+
+namespace map { namespace detail {
+
+CompressType::CompressType()
+	: type(NONE_COMPRESS)
+{ }
+
+CompressType::CompressType(CompressEnum type) {
+	assert(type >= NONE_COMPRESS && type < N_COMPRESS);
+	this->type = type;
+}
+
+CompressEnum CompressType::get() const {
+	return type;
+}
+
+bool CompressType::operator==(CompressType type) const {
+	return this->get() == type.get();
+}
+
+bool CompressType::operator!=(CompressType type) const {
+	return this->get() != type.get();
+}
+
+std::string CompressType::toString() const {
+	switch (type) {
+		case NONE_COMPRESS: return std::string("NONE");
+		case DEFLATE: return std::string("DEFLATE");
+		case LZW: return std::string("LZW");
+		case ZSTD: return std::string("ZSTD");
+		default: assert(0);
+	}
+}
+
+} } // namespace map::detail
@@ -0,0 +1,38 @@
+/**
+ * @file	CompressType.hpp 
+ * @author	Jesús Carabaño Bravo <jcaraban@abo.fi>
+ *
+ * Note: compression of the output files, only <tiff> supports it currently
+ */
+
+#ifndef MAP_UTIL_COMPRESSTYPE_HPP_
+#define MAP_UTIL_COMPRESSTYPE_HPP_
+
+#include <string>
+
+
+namespace map { namespace detail {
+
+// Enum
+
+enum CompressEnum : int { NONE_COMPRESS, DEFLATE, LZW, ZSTD, N_COMPRESS };
+
+// Class
+
+class CompressType {
+	CompressEnum type;
+
+  public:
+  	CompressType();
+  	CompressType(CompressEnum type);
+  	CompressEnum get() const;
+
+  	bool operator==(CompressType type) const;
+  	bool operator!=(CompressType type) const;
+
+	std::string toString() const;
+};
+
+} } // namespace map::detail
+
+#endif
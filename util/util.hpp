@@ -22,6 +22,7 @@
 #include "ReductionType.hpp"
 #include "DiversityType.hpp"
 #include "PercentType.hpp"
+#include "CompressType.hpp"
 
 #include "Mask.hpp"
 